@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../src/arr.h"
+
+/*-- ways to fill an arr, in ns per element. --*/
+
+static double now_s() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// the size of a chunk_vtx
+typedef struct bench_vtx {
+  float v[6];
+} bench_vtx;
+
+static bench_vtx vtx_at(int i) {
+  return (bench_vtx){{(float)i, 0, (float)-i, 0, 1, 0}};
+}
+
+static uint16_t ind_at(int i) {
+  return (uint16_t)i;
+}
+
+// reads the arr back so the fill can not be optimized out
+static size_t sink;
+
+// one set of fills for element type T, made by T's at function. n is a
+// multiple of 6, so arr_add_n can append quads like chunk_build_inds.
+#define bench_definition(name, T, at_fn)                                       \
+static double name##_add(int n) {                                              \
+  double t0 = now_s();                                                         \
+  T* a = arr_new(T, 1);                                                        \
+  for (int i = 0; i < n; i++) {                                                \
+    T v = at_fn(i);                                                            \
+    arr_add(&a, &v);                                                           \
+  }                                                                            \
+  double t = now_s() - t0;                                                     \
+                                                                               \
+  sink += arr_len(a) + (size_t)*(byte*)arr_last(a);                            \
+  arr_del(a);                                                                  \
+  return t;                                                                    \
+}                                                                              \
+                                                                               \
+static double name##_push(int n) {                                             \
+  double t0 = now_s();                                                         \
+  T* a = arr_new(T, 1);                                                        \
+  for (int i = 0; i < n; i++) {                                                \
+    arr_push(a, at_fn(i));                                                     \
+  }                                                                            \
+  double t = now_s() - t0;                                                     \
+                                                                               \
+  sink += arr_len(a) + (size_t)*(byte*)arr_last(a);                            \
+  arr_del(a);                                                                  \
+  return t;                                                                    \
+}                                                                              \
+                                                                               \
+static double name##_push_reserved(int n) {                                    \
+  double t0 = now_s();                                                         \
+  T* a = arr_new(T, 1);                                                        \
+  arr_reserve(&a, n);                                                          \
+  for (int i = 0; i < n; i++) {                                                \
+    arr_push_reserved(a, at_fn(i));                                            \
+  }                                                                            \
+  double t = now_s() - t0;                                                     \
+                                                                               \
+  sink += arr_len(a) + (size_t)*(byte*)arr_last(a);                            \
+  arr_del(a);                                                                  \
+  return t;                                                                    \
+}                                                                              \
+                                                                               \
+static double name##_add_n(int n) {                                            \
+  double t0 = now_s();                                                         \
+  T* a = arr_new(T, 1);                                                        \
+  for (int i = 0; i < n; i += 6) {                                             \
+    T quad[6];                                                                 \
+    for (int j = 0; j < 6; j++) {                                              \
+      quad[j] = at_fn(i + j);                                                  \
+    }                                                                          \
+    arr_add_n(&a, quad, 6);                                                    \
+  }                                                                            \
+  double t = now_s() - t0;                                                     \
+                                                                               \
+  sink += arr_len(a) + (size_t)*(byte*)arr_last(a);                            \
+  arr_del(a);                                                                  \
+  return t;                                                                    \
+}                                                                              \
+                                                                               \
+static double name##_raw(int n) {                                              \
+  double t0 = now_s();                                                         \
+  T* a = malloc(sizeof(T) * n);                                                \
+  for (int i = 0; i < n; i++) {                                                \
+    a[i] = at_fn(i);                                                           \
+  }                                                                            \
+  double t = now_s() - t0;                                                     \
+                                                                               \
+  sink += (size_t)*(byte*)&a[n - 1];                                           \
+  free(a);                                                                     \
+  return t;                                                                    \
+}                                                                              \
+                                                                               \
+/* fills n elements reps times, so small arrs run long enough to time */     \
+static double name##_time(double (* fill)(int), int n, int reps) {             \
+  double t = 0;                                                                \
+  for (int r = 0; r < reps; r++) {                                             \
+    t += fill(n);                                                              \
+  }                                                                            \
+                                                                               \
+  return t * 1e9 / ((double)n * reps);                                         \
+}                                                                              \
+                                                                               \
+static void name##_bench(char const* type_name, int n, int reps) {             \
+  printf("%s, %d elements:\n", type_name, n);                                  \
+  printf("  arr_add              %6.2f\n", name##_time(name##_add, n, reps));  \
+  printf("  arr_push             %6.2f\n", name##_time(name##_push, n, reps)); \
+  printf("  arr_push_reserved    %6.2f\n",                                     \
+         name##_time(name##_push_reserved, n, reps));                          \
+  printf("  arr_add_n, 6 a time  %6.2f\n",                                     \
+         name##_time(name##_add_n, n, reps));                                  \
+  printf("  malloc'd array       %6.2f\n", name##_time(name##_raw, n, reps));  \
+}
+
+bench_definition(bench_ind, uint16_t, ind_at)
+bench_definition(bench_vtx, bench_vtx, vtx_at)
+
+#define bench_n_elems (6 << 22)
+
+int main() {
+  // about a chunk's worth of vertices or indices, then big fills that realloc
+  // many times over
+  static const int sizes[] = {384, 6 << 12, bench_n_elems};
+
+  for (int s = 0; s < 3; s++) {
+    int reps = bench_n_elems / sizes[s];
+    bench_ind_bench("uint16_t", sizes[s], reps);
+    bench_vtx_bench("24 byte vertex", sizes[s], reps);
+    printf("\n");
+    fflush(stdout);
+  }
+
+  return sink == 0;
+}
\ No newline at end of file
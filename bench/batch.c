@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/batch.h"
+
+/*-- the batch kernels against one typedefs.h call per entity, in millions of
+     entities per second. --*/
+
+static double now_s() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ull;
+
+static float rng_float() {
+  uint64_t z = (rng_state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  z ^= z >> 31;
+  return (float)(z >> 40) / (float)(1 << 24) * 2 - 1;
+}
+
+// a crowd, stored both ways: one v3f per entity, and one array per component
+typedef struct crowd {
+  int n;
+
+  v3f* pos, * prev_pos, * scale, * axis;
+  float* angle;
+
+  float* soa;
+  v3_soa s_pos, s_prev_pos, s_scale, s_out;
+  v4_soa s_rot;
+
+  v3f* out;
+  m4f* models;
+} crowd;
+
+static float* soa_slice(crowd* c, int i) {
+  return c->soa + (size_t)i * c->n;
+}
+
+static crowd crowd_new(int n) {
+  crowd c = {
+    .n = n,
+    .pos = malloc(sizeof(v3f) * n),
+    .prev_pos = malloc(sizeof(v3f) * n),
+    .scale = malloc(sizeof(v3f) * n),
+    .axis = malloc(sizeof(v3f) * n),
+    .angle = malloc(sizeof(float) * n),
+    .soa = malloc(sizeof(float) * n * 16),
+    .out = malloc(sizeof(v3f) * n),
+    .models = malloc(sizeof(m4f) * n),
+  };
+
+  c.s_pos = (v3_soa){soa_slice(&c, 0), soa_slice(&c, 1), soa_slice(&c, 2)};
+  c.s_prev_pos = (v3_soa){soa_slice(&c, 3), soa_slice(&c, 4), soa_slice(&c, 5)};
+  c.s_scale = (v3_soa){soa_slice(&c, 6), soa_slice(&c, 7), soa_slice(&c, 8)};
+  c.s_rot = (v4_soa){soa_slice(&c, 9), soa_slice(&c, 10), soa_slice(&c, 11),
+                     soa_slice(&c, 12)};
+  c.s_out = (v3_soa){soa_slice(&c, 13), soa_slice(&c, 14), soa_slice(&c, 15)};
+
+  for (int i = 0; i < n; i++) {
+    c.pos[i] = (v3f){rng_float() * 512, rng_float() * 32, rng_float() * 512};
+    c.prev_pos[i] = v3_add(c.pos[i], (v3f){rng_float(), 0, rng_float()});
+    c.scale[i] = (v3f){1 + rng_float() * 0.2f, 1 + rng_float() * 0.2f,
+                       1 + rng_float() * 0.2f};
+    c.axis[i] = v3_normed((v3f){rng_float(), rng_float() + 2, rng_float()});
+    c.angle[i] = rng_float() * 3;
+
+    c.s_pos.x[i] = c.pos[i].x;
+    c.s_pos.y[i] = c.pos[i].y;
+    c.s_pos.z[i] = c.pos[i].z;
+    c.s_prev_pos.x[i] = c.prev_pos[i].x;
+    c.s_prev_pos.y[i] = c.prev_pos[i].y;
+    c.s_prev_pos.z[i] = c.prev_pos[i].z;
+    c.s_scale.x[i] = c.scale[i].x;
+    c.s_scale.y[i] = c.scale[i].y;
+    c.s_scale.z[i] = c.scale[i].z;
+
+    float s = sinf(c.angle[i] * 0.5f);
+    c.s_rot.x[i] = c.axis[i].x * s;
+    c.s_rot.y[i] = c.axis[i].y * s;
+    c.s_rot.z[i] = c.axis[i].z * s;
+    c.s_rot.w[i] = cosf(c.angle[i] * 0.5f);
+  }
+
+  return c;
+}
+
+static void crowd_del(crowd* c) {
+  free(c->pos);
+  free(c->prev_pos);
+  free(c->scale);
+  free(c->axis);
+  free(c->angle);
+  free(c->soa);
+  free(c->out);
+  free(c->models);
+}
+
+static m4f view;
+
+static m4f compose_one(crowd* c, int i) {
+  return m4_mul(m4_mul(m4_scale_v(c->scale[i]), m4_rot(c->axis[i], c->angle[i])),
+                m4_trans_v(c->pos[i]));
+}
+
+static void scalar_transform(crowd* c) {
+  for (int i = 0; i < c->n; i++) {
+    c->out[i] = m4_transform_point(&view, c->pos[i]);
+  }
+}
+
+static void batch_transform(crowd* c) {
+  batch_transform_points(&view, c->s_pos, c->s_out, c->n);
+}
+
+static void scalar_compose(crowd* c) {
+  for (int i = 0; i < c->n; i++) {
+    c->models[i] = compose_one(c, i);
+  }
+}
+
+static void batch_compose(crowd* c) {
+  batch_compose_models(c->s_pos, c->s_rot, c->s_scale, c->models, c->n);
+}
+
+static void scalar_lerp(crowd* c) {
+  for (int i = 0; i < c->n; i++) {
+    c->out[i] = v3_lerp(c->prev_pos[i], c->pos[i], 0.37f);
+  }
+}
+
+static void batch_lerp_all(crowd* c) {
+  batch_lerp(c->s_prev_pos, c->s_pos, 0.37f, c->s_out, c->n);
+}
+
+static bool is_near(float a, float b) {
+  return fabsf(a - b) <= batch_tolerance * fmaxf(1, fabsf(b));
+}
+
+static bool check(crowd* c) {
+  bool ok = true;
+
+  batch_transform(c);
+  for (int i = 0; i < c->n && ok; i++) {
+    v3f p = m4_transform_point(&view, c->pos[i]);
+    if (!is_near(c->s_out.x[i], p.x) || !is_near(c->s_out.y[i], p.y) ||
+        !is_near(c->s_out.z[i], p.z)) {
+      printf("batch_transform_points is off at %d\n", i);
+      ok = false;
+    }
+  }
+
+  batch_lerp_all(c);
+  for (int i = 0; i < c->n && ok; i++) {
+    v3f p = v3_lerp(c->prev_pos[i], c->pos[i], 0.37f);
+    if (!is_near(c->s_out.x[i], p.x) || !is_near(c->s_out.y[i], p.y) ||
+        !is_near(c->s_out.z[i], p.z)) {
+      printf("batch_lerp is off at %d\n", i);
+      ok = false;
+    }
+  }
+
+  batch_compose(c);
+  for (int i = 0; i < c->n && ok; i++) {
+    m4f m = compose_one(c, i);
+    for (int j = 0; j < 16; j++) {
+      if (!is_near(c->models[i].v[j / 4][j % 4], m.v[j / 4][j % 4])) {
+        printf("batch_compose_models is off at %d\n", i);
+        ok = false;
+        break;
+      }
+    }
+  }
+
+  return ok;
+}
+
+// entities per second in millions, over enough passes to take a while
+static double time_pass(void (* pass)(crowd*), crowd* c) {
+  int reps = (1 << 24) / c->n + 1;
+
+  double t0 = now_s();
+  for (int r = 0; r < reps; r++) {
+    pass(c);
+  }
+
+  return (double)c->n * reps / (now_s() - t0) * 1e-6;
+}
+
+static void report(char const* op, void (* scalar)(crowd*),
+                   void (* batch)(crowd*), crowd* c) {
+  double s = time_pass(scalar, c), b = time_pass(batch, c);
+  printf("  %-10s %8.1f -> %8.1f  (%.2fx)\n", op, s, b, b / s);
+  fflush(stdout);
+}
+
+int main() {
+  view = m4_mul(m4_look((v3f){3, 40, -7}, (v3f){0.3f, -0.4f, 1}, v3_uy),
+                m4_persp(1.2f, 16.f / 9.f, 0.1f, 768.f));
+
+  // a crowd that fits in l1, one in l2, and one that streams from memory.
+  // odd sizes so every pass has a tail.
+  static const int sizes[] = {1001, 16381, 1 << 20 | 3};
+
+  for (int s = 0; s < 3; s++) {
+    crowd c = crowd_new(sizes[s]);
+    if (!check(&c)) {
+      return 1;
+    }
+
+    printf("%d entities (%s), millions/s, per-entity calls -> batched:\n",
+           c.n, batch_get_isa());
+    report("transform", scalar_transform, batch_transform, &c);
+    report("compose", scalar_compose, batch_compose, &c);
+    report("lerp", scalar_lerp, batch_lerp_all, &c);
+    printf("\n");
+
+    crowd_del(&c);
+  }
+
+  return 0;
+}
\ No newline at end of file
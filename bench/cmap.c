@@ -0,0 +1,336 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <pthread.h>
+#include "../src/cmap.h"
+
+/*-- cmap under contention: a stress test that checks the map stays
+ *   consistent, then throughput from 1 to 32 threads. --*/
+
+static double now_s() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static uint64_t rng_next(uint64_t* s) {
+  *s ^= *s << 13;
+  *s ^= *s >> 7;
+  *s ^= *s << 17;
+  return *s;
+}
+
+// what a value holds once its inserter has filled it in
+static uint64_t key_tag(v2i key) {
+  return hash_i32x2(key.v[0], key.v[1]) | 1;
+}
+
+#define stress_max_threads 32
+#define stress_n_pinned 4096
+#define stress_n_churn 4096
+#define stress_n_shared 4096
+#define stress_n_ops 200000
+
+typedef struct stress_ctx {
+  cmap* m;
+  int n_threads;
+
+  // how many threads saw is_new for each shared key; must end at 1
+  atomic_int shared_news[stress_n_shared];
+  atomic_int n_errors;
+  pthread_barrier_t start;
+} stress_ctx;
+
+typedef struct stress_thread {
+  stress_ctx* ctx;
+  int id;
+
+  // where each pinned value was first put, checked again after the churn
+  _Atomic uint64_t* pinned[stress_n_pinned];
+
+  // which of this thread's churn keys are in the map at the end
+  bool is_live[stress_n_churn];
+} stress_thread;
+
+static void stress_fail(stress_ctx* ctx, char const* what, v2i key) {
+  if (atomic_fetch_add(&ctx->n_errors, 1) < 8) {
+    fprintf(stderr, "stress: %s at (%d, %d)\n", what, key.v[0], key.v[1]);
+  }
+}
+
+static void* stress_run(void* arg) {
+  stress_thread* t = arg;
+  stress_ctx* ctx = t->ctx;
+  uint64_t rng = 0x9e3779b97f4a7c15ull * (t->id + 1);
+  bool is_new;
+
+  pthread_barrier_wait(&ctx->start);
+
+  // the pinned keys are inserted while every other thread is also growing
+  // the map, and must not move until the end
+  for (int i = 0; i < stress_n_pinned; i++) {
+    v2i key = {{t->id, i}};
+    t->pinned[i] = cmap_get_or_insert(ctx->m, &key, &is_new);
+    if (!is_new) {
+      stress_fail(ctx, "pinned key already present", key);
+    }
+
+    atomic_store(t->pinned[i], key_tag(key));
+  }
+
+  for (int i = 0; i < stress_n_ops; i++) {
+    uint64_t r = rng_next(&rng);
+    int k = (int)((r >> 8) % stress_n_churn);
+
+    // churn keys are only inserted and removed by their thread, so their
+    // values can be checked; another thread's may be reused under us, so
+    // only their presence is looked up
+    v2i own = {{1000 + t->id, k}};
+    v2i other = {{1000 + (int)(r % ctx->n_threads), k}};
+    v2i shared = {{-1, (int)((r >> 32) % stress_n_shared)}};
+
+    switch (r & 7) {
+      case 0:
+      case 1: {
+        _Atomic uint64_t* v = cmap_get_or_insert(ctx->m, &own, &is_new);
+        if (is_new == t->is_live[k]) {
+          stress_fail(ctx, "insert disagrees with is_live", own);
+        }
+
+        if (is_new) {
+          atomic_store(v, key_tag(own));
+        } else if (atomic_load(v) != key_tag(own)) {
+          stress_fail(ctx, "own value overwritten", own);
+        }
+
+        t->is_live[k] = true;
+        break;
+      }
+      case 2: {
+        if (cmap_remove(ctx->m, &own) != t->is_live[k]) {
+          stress_fail(ctx, "remove disagrees with is_live", own);
+        }
+
+        t->is_live[k] = false;
+        break;
+      }
+      case 3: {
+        _Atomic uint64_t* v = cmap_at(ctx->m, &own);
+        if ((v != NULL) != t->is_live[k]) {
+          stress_fail(ctx, "at disagrees with is_live", own);
+        } else if (v && atomic_load(v) != key_tag(own)) {
+          stress_fail(ctx, "own value overwritten", own);
+        }
+        break;
+      }
+      case 4: {
+        cmap_get_or_insert(ctx->m, &shared, &is_new);
+        if (is_new) {
+          atomic_fetch_add(&ctx->shared_news[shared.v[1]], 1);
+        }
+        break;
+      }
+      default: {
+        cmap_at(ctx->m, &other);
+        break;
+      }
+    }
+  }
+
+  for (int i = 0; i < stress_n_pinned; i++) {
+    v2i key = {{t->id, i}};
+    if (cmap_at(ctx->m, &key) != t->pinned[i]) {
+      stress_fail(ctx, "pinned value moved", key);
+    } else if (atomic_load(t->pinned[i]) != key_tag(key)) {
+      stress_fail(ctx, "pinned value overwritten", key);
+    }
+  }
+
+  return NULL;
+}
+
+static bool stress(int n_threads) {
+  stress_ctx* ctx = calloc(1, sizeof(stress_ctx));
+  stress_thread* ts = calloc(n_threads, sizeof(stress_thread));
+  pthread_t* ids = malloc(sizeof(pthread_t) * n_threads);
+
+  // starts small, so the shards grow many times during the run
+  ctx->m = cmap_new(sizeof(v2i), sizeof(uint64_t), iv2_eq, iv2_hash);
+  ctx->n_threads = n_threads;
+  pthread_barrier_init(&ctx->start, NULL, n_threads);
+
+  for (int i = 0; i < n_threads; i++) {
+    ts[i] = (stress_thread){.ctx = ctx, .id = i};
+    pthread_create(&ids[i], NULL, stress_run, &ts[i]);
+  }
+
+  size_t n_expected = (size_t)n_threads * stress_n_pinned;
+  for (int i = 0; i < n_threads; i++) {
+    pthread_join(ids[i], NULL);
+    for (int k = 0; k < stress_n_churn; k++) {
+      n_expected += ts[i].is_live[k];
+    }
+  }
+
+  for (int i = 0; i < stress_n_shared; i++) {
+    int n_news = atomic_load(&ctx->shared_news[i]);
+    v2i key = {{-1, i}};
+    if (n_news > 1) {
+      stress_fail(ctx, "shared key inserted twice", key);
+    }
+
+    n_expected += n_news;
+  }
+
+  size_t n = cmap_get_size(ctx->m);
+  if (n != n_expected) {
+    fprintf(stderr, "stress: %zu entries, expected %zu\n", n, n_expected);
+    atomic_fetch_add(&ctx->n_errors, 1);
+  }
+
+  int n_errors = atomic_load(&ctx->n_errors);
+  printf("stress, %2d threads: %s\n", n_threads, n_errors ? "FAILED" : "ok");
+
+  pthread_barrier_destroy(&ctx->start);
+  cmap_del(ctx->m);
+  free(ids);
+  free(ts);
+  free(ctx);
+  return n_errors == 0;
+}
+
+// the scaling run: a world-sized key set, mostly looked up, sometimes
+// requested or forgotten like chunks scrolling in and out
+#define scale_side 256
+#define scale_n_ops 2000000
+
+typedef struct scale_ctx {
+  cmap* m;
+
+  // the baseline: one map behind one lock
+  map* locked;
+  pthread_mutex_t lock;
+
+  int n_threads;
+  pthread_barrier_t start;
+} scale_ctx;
+
+typedef struct scale_thread {
+  scale_ctx* ctx;
+  int id;
+  size_t n_found;
+} scale_thread;
+
+static void* scale_run(void* arg) {
+  scale_thread* t = arg;
+  scale_ctx* ctx = t->ctx;
+  uint64_t rng = 0x9e3779b97f4a7c15ull * (t->id + 1);
+  bool is_new;
+
+  pthread_barrier_wait(&ctx->start);
+
+  for (int i = 0; i < scale_n_ops / ctx->n_threads; i++) {
+    uint64_t r = rng_next(&rng);
+    v2i key = {{(int)((r >> 40) % scale_side), (int)((r >> 16) % scale_side)}};
+
+    // 90% reads, 5% inserts, 5% removes
+    int op = (int)(r & 0xff) % 20;
+
+    if (ctx->locked) {
+      pthread_mutex_lock(&ctx->lock);
+      if (op < 18) {
+        t->n_found += map_at(ctx->locked, &key) != NULL;
+      } else if (op == 18) {
+        map_get_or_insert(ctx->locked, &key, &is_new);
+      } else {
+        map_remove(ctx->locked, &key);
+      }
+      pthread_mutex_unlock(&ctx->lock);
+    } else {
+      if (op < 18) {
+        t->n_found += cmap_at(ctx->m, &key) != NULL;
+      } else if (op == 18) {
+        cmap_get_or_insert(ctx->m, &key, &is_new);
+      } else {
+        cmap_remove(ctx->m, &key);
+      }
+    }
+  }
+
+  return NULL;
+}
+
+// million ops per second over all threads
+static double scale(int n_threads, bool is_locked) {
+  scale_ctx ctx = {
+    .m = cmap_new(sizeof(v2i), sizeof(uint64_t), iv2_eq, iv2_hash),
+    .n_threads = n_threads,
+  };
+
+  map locked = map_new(4, sizeof(v2i), sizeof(uint64_t), 0.75f, iv2_eq,
+                       iv2_hash);
+  if (is_locked) {
+    ctx.locked = &locked;
+    pthread_mutex_init(&ctx.lock, NULL);
+  }
+
+  // half the key set starts resident
+  bool is_new;
+  for (int x = 0; x < scale_side; x++) {
+    for (int z = 0; z < scale_side; z += 2) {
+      v2i key = {{x, z}};
+      cmap_get_or_insert(ctx.m, &key, &is_new);
+      map_get_or_insert(&locked, &key, &is_new);
+    }
+  }
+
+  // the main thread waits at the barrier too, so the clock starts with the
+  // workers
+  pthread_barrier_init(&ctx.start, NULL, n_threads + 1);
+  scale_thread* ts = calloc(n_threads, sizeof(scale_thread));
+  pthread_t* ids = malloc(sizeof(pthread_t) * n_threads);
+  for (int i = 0; i < n_threads; i++) {
+    ts[i] = (scale_thread){.ctx = &ctx, .id = i};
+    pthread_create(&ids[i], NULL, scale_run, &ts[i]);
+  }
+
+  pthread_barrier_wait(&ctx.start);
+  double t0 = now_s();
+  for (int i = 0; i < n_threads; i++) {
+    pthread_join(ids[i], NULL);
+  }
+  double t = now_s() - t0;
+
+  if (is_locked) {
+    pthread_mutex_destroy(&ctx.lock);
+  }
+
+  pthread_barrier_destroy(&ctx.start);
+  cmap_del(ctx.m);
+  map_del(&locked);
+  free(ids);
+  free(ts);
+
+  int n_ops = scale_n_ops / n_threads * n_threads;
+  return n_ops / t * 1e-6;
+}
+
+int main() {
+  static const int n_threads[] = {1, 2, 4, 8, 16, 32};
+
+  bool is_ok = true;
+  for (int i = 0; i < 6; i++) {
+    is_ok &= stress(n_threads[i]);
+  }
+
+  printf("\n%dx%d keys, 90%% reads, Mops/s:\n", scale_side, scale_side);
+  printf("threads      cmap  one lock\n");
+  for (int i = 0; i < 6; i++) {
+    printf("%7d  %8.2f  %8.2f\n", n_threads[i], scale(n_threads[i], false),
+           scale(n_threads[i], true));
+    fflush(stdout);
+  }
+
+  return !is_ok;
+}
\ No newline at end of file
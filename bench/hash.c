@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "../src/hash.h"
+
+/*-- avalanche and collision checks for the hashes in hash.h. --*/
+
+// iv2_hash before hash.h: y sign-extends over x whenever it is negative
+static uint64_t old_iv2_hash(int32_t x, int32_t y) {
+  return ((uint64_t)x << 32) | (uint64_t)(int64_t)y;
+}
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ull;
+
+// splitmix64
+static uint64_t rng() {
+  uint64_t z = (rng_state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+// every hash under test takes n_bytes of input
+typedef struct hash_fn {
+  char const* name;
+  int n_bytes;
+  uint64_t (* fn)(uint8_t const* in);
+} hash_fn;
+
+static uint64_t hash_old_iv2(uint8_t const* in) {
+  int32_t v[2];
+  memcpy(v, in, 8);
+  return old_iv2_hash(v[0], v[1]);
+}
+
+static uint64_t hash_iv2(uint8_t const* in) {
+  int32_t v[2];
+  memcpy(v, in, 8);
+  return hash_i32x2(v[0], v[1]);
+}
+
+static uint64_t hash_mix_u64(uint8_t const* in) {
+  uint64_t x;
+  memcpy(&x, in, 8);
+  return hash_mix(x);
+}
+
+static uint64_t hash_bytes_8(uint8_t const* in) {
+  return hash_bytes(in, 8);
+}
+
+static uint64_t hash_bytes_13(uint8_t const* in) {
+  return hash_bytes(in, 13);
+}
+
+static uint64_t hash_bytes_40(uint8_t const* in) {
+  return hash_bytes(in, 40);
+}
+
+static const hash_fn fns[] = {
+  {"old iv2_hash", 8, hash_old_iv2},
+  {"hash_i32x2", 8, hash_iv2},
+  {"hash_mix", 8, hash_mix_u64},
+  {"hash_bytes 8", 8, hash_bytes_8},
+  {"hash_bytes 13", 13, hash_bytes_13},
+  {"hash_bytes 40", 40, hash_bytes_40},
+};
+
+static const int n_fns = sizeof(fns) / sizeof(fns[0]);
+
+// flips each input bit of random inputs and counts how often each output bit
+// follows. ideal is 0.5 for every pair; reports the worst and the mean
+// distance from it.
+static void avalanche(hash_fn const* f, int n_trials) {
+  int n_in = f->n_bytes * 8;
+  int* flips = calloc(n_in * 64, sizeof(int));
+  uint8_t in[64];
+
+  for (int t = 0; t < n_trials; t++) {
+    for (int i = 0; i < f->n_bytes; i++) {
+      in[i] = (uint8_t)rng();
+    }
+
+    uint64_t h = f->fn(in);
+    for (int b = 0; b < n_in; b++) {
+      in[b / 8] ^= (uint8_t)(1 << (b % 8));
+      uint64_t diff = h ^ f->fn(in);
+      in[b / 8] ^= (uint8_t)(1 << (b % 8));
+
+      for (int o = 0; o < 64; o++) {
+        flips[b * 64 + o] += (int)((diff >> o) & 1);
+      }
+    }
+  }
+
+  double worst = 0, mean = 0;
+  for (int i = 0; i < n_in * 64; i++) {
+    double bias = fabs((double)flips[i] / n_trials - 0.5);
+    worst = fmax(worst, bias);
+    mean += bias;
+  }
+
+  mean /= n_in * 64;
+  printf("%-14s avalanche bias: worst %.3f  mean %.4f\n", f->name, worst,
+         mean);
+  free(flips);
+}
+
+static int u64_cmp(void const* lhs, void const* rhs) {
+  uint64_t l = *(uint64_t const*)lhs, r = *(uint64_t const*)rhs;
+  return (l > r) - (l < r);
+}
+
+// buckets hashes by bits [shift, shift + log2(n_buckets)) and reports the
+// fullest bucket and the fraction of empty ones, which is 1/e for a random
+// hash at one key per bucket
+static void report_buckets(char const* what, uint64_t* hs, size_t n,
+                           size_t n_buckets, int shift) {
+  uint32_t* counts = calloc(n_buckets, sizeof(uint32_t));
+  for (size_t i = 0; i < n; i++) {
+    counts[(hs[i] >> shift) & (n_buckets - 1)]++;
+  }
+
+  uint32_t fullest = 0;
+  size_t n_empty = 0;
+  for (size_t i = 0; i < n_buckets; i++) {
+    fullest = counts[i] > fullest ? counts[i] : fullest;
+    n_empty += counts[i] == 0;
+  }
+
+  printf("    %-10s fullest bucket %7u  empty %.3f\n", what, fullest,
+         (double)n_empty / (double)n_buckets);
+  free(counts);
+}
+
+// a side x side square of chunk positions around the origin, the keys the
+// world actually uses
+static void chunk_keys(hash_fn const* f, int side) {
+  size_t n = (size_t)side * side;
+  uint64_t* hs = malloc(sizeof(uint64_t) * n);
+  uint8_t in[64] = {};
+
+  for (int i = 0; i < side; i++) {
+    for (int j = 0; j < side; j++) {
+      int32_t v[2] = {i - side / 2, j - side / 2};
+      memcpy(in, v, 8);
+      hs[(size_t)i * side + j] = f->fn(in);
+    }
+  }
+
+  printf("%-14s %dx%d chunk positions\n", f->name, side, side);
+
+  // map takes the slot from above bit 7 and the control byte from below
+  report_buckets("bits 7+", hs, n, n, 7);
+  report_buckets("bits 0+", hs, n, n, 0);
+
+  qsort(hs, n, sizeof(uint64_t), u64_cmp);
+  size_t n_dups = 0;
+  for (size_t i = 1; i < n; i++) {
+    n_dups += hs[i] == hs[i - 1];
+  }
+
+  printf("    %zu full 64 bit collisions\n", n_dups);
+  free(hs);
+}
+
+int main(int argc, char** argv) {
+  int n_trials = argc > 1 ? atoi(argv[1]) : 20000;
+
+  for (int i = 0; i < n_fns; i++) {
+    avalanche(&fns[i], n_trials);
+  }
+
+  printf("\n");
+  for (int i = 0; i < n_fns; i++) {
+    if (fns[i].n_bytes == 8) {
+      chunk_keys(&fns[i], 1024);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../src/map.h"
+#include "map_chained.h"
+
+/*-- map vs the old chained map on v2i keys, in ns per operation. --*/
+
+static double now_s() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// the chunk positions of a square around the origin, in random order, and as
+// many positions just outside it to miss with
+static void make_keys(v2i* hits, v2i* misses, int n) {
+  int side = 1;
+  while (side * side < n) {
+    side++;
+  }
+
+  for (int i = 0; i < n; i++) {
+    hits[i] = (v2i){{i / side - side / 2, i % side - side / 2}};
+    misses[i] = (v2i){{i / side - side / 2, i % side + side - side / 2}};
+  }
+
+  for (int i = n - 1; i > 0; i--) {
+    int j = rand() % (i + 1);
+    v2i t = hits[i];
+    hits[i] = hits[j];
+    hits[j] = t;
+  }
+}
+
+map_definition(typed_map, v2i, size_t, iv2_hash, iv2_eq)
+
+// what world.chunks is: v2i to a chunk pointer
+map_definition(typed_chunk_map, v2i, void*, iv2_hash, iv2_eq)
+
+typedef struct bench_times {
+  double add, hit, miss, remove;
+} bench_times;
+
+static void print_times(char const* name, int n, bench_times t) {
+  double ns = 1e9 / n;
+  printf("%-22s %9d  add %7.1f  hit %7.1f  miss %7.1f  remove %7.1f\n", name,
+         n, t.add * ns, t.hit * ns, t.miss * ns, t.remove * ns);
+}
+
+// sums the values found so the lookups can not be optimized out
+static size_t sink;
+
+static bench_times bench_map(v2i* hits, v2i* misses, int n,
+                             bool is_reserved) {
+  bench_times t;
+  map m = map_new(4, sizeof(v2i), sizeof(size_t), 0.75f, iv2_eq, iv2_hash);
+
+  // the reserve is part of the timed bulk load
+  double t0 = now_s();
+  if (is_reserved) {
+    map_reserve(&m, n);
+  }
+
+  for (size_t i = 0; i < (size_t)n; i++) {
+    map_add(&m, &hits[i], &i);
+  }
+  t.add = now_s() - t0;
+
+  t0 = now_s();
+  for (int i = 0; i < n; i++) {
+    sink += *(size_t*)map_at(&m, &hits[i]);
+  }
+  t.hit = now_s() - t0;
+
+  t0 = now_s();
+  for (int i = 0; i < n; i++) {
+    sink += map_at(&m, &misses[i]) != NULL;
+  }
+  t.miss = now_s() - t0;
+
+  t0 = now_s();
+  for (int i = 0; i < n; i++) {
+    sink += map_remove(&m, &hits[i]);
+  }
+  t.remove = now_s() - t0;
+
+  map_del(&m);
+  return t;
+}
+
+static bench_times bench_typed_map(v2i* hits, v2i* misses, int n) {
+  bench_times t;
+  typed_map m = typed_map_new(4, 0.75f);
+
+  double t0 = now_s();
+  for (size_t i = 0; i < (size_t)n; i++) {
+    typed_map_add(&m, hits[i], i);
+  }
+  t.add = now_s() - t0;
+
+  t0 = now_s();
+  for (int i = 0; i < n; i++) {
+    sink += *typed_map_at(&m, hits[i]);
+  }
+  t.hit = now_s() - t0;
+
+  t0 = now_s();
+  for (int i = 0; i < n; i++) {
+    sink += typed_map_at(&m, misses[i]) != NULL;
+  }
+  t.miss = now_s() - t0;
+
+  t0 = now_s();
+  for (int i = 0; i < n; i++) {
+    sink += typed_map_remove(&m, hits[i]);
+  }
+  t.remove = now_s() - t0;
+
+  typed_map_del(&m);
+  return t;
+}
+
+// the chunk map's traffic as the camera walks in x: every chunk of the
+// window is looked up or inserted each frame, and the column left behind is
+// removed. returns ns per operation.
+#define bench_window 65
+#define bench_frames 512
+
+static double bench_chunk_workload(bool is_typed) {
+  map m = map_new(4, sizeof(v2i), sizeof(void*), 0.75f, iv2_eq, iv2_hash);
+  typed_chunk_map tm = typed_chunk_map_new(4, 0.75f);
+  size_t n_ops = 0;
+
+  double t0 = now_s();
+  for (int f = 0; f < bench_frames; f++) {
+    for (int i = 0; i < bench_window; i++) {
+      for (int j = 0; j < bench_window; j++) {
+        v2i pos = {{f + i - bench_window / 2, j - bench_window / 2}};
+        bool is_new;
+        void** ch = is_typed ? typed_chunk_map_get_or_insert(&tm, pos, &is_new)
+                             : map_get_or_insert(&m, &pos, &is_new);
+        if (is_new) {
+          *ch = &sink;
+        }
+
+        sink += *ch != NULL;
+      }
+    }
+
+    for (int j = 0; j < bench_window; j++) {
+      v2i pos = {{f - bench_window / 2, j - bench_window / 2}};
+      sink += is_typed ? typed_chunk_map_remove(&tm, pos)
+                       : map_remove(&m, &pos);
+    }
+
+    n_ops += bench_window * bench_window + bench_window;
+  }
+
+  double t = now_s() - t0;
+  map_del(&m);
+  typed_chunk_map_del(&tm);
+  return t * 1e9 / (double)n_ops;
+}
+
+static bench_times bench_chained_map(v2i* hits, v2i* misses, int n) {
+  bench_times t;
+  chained_map m =
+    chained_map_new(4, sizeof(v2i), sizeof(size_t), 0.75f, iv2_eq, iv2_hash);
+
+  double t0 = now_s();
+  for (size_t i = 0; i < (size_t)n; i++) {
+    chained_map_add(&m, &hits[i], &i);
+  }
+  t.add = now_s() - t0;
+
+  t0 = now_s();
+  for (int i = 0; i < n; i++) {
+    sink += *(size_t*)chained_map_at(&m, &hits[i]);
+  }
+  t.hit = now_s() - t0;
+
+  t0 = now_s();
+  for (int i = 0; i < n; i++) {
+    sink += chained_map_at(&m, &misses[i]) != NULL;
+  }
+  t.miss = now_s() - t0;
+
+  t0 = now_s();
+  for (int i = 0; i < n; i++) {
+    sink += chained_map_remove(&m, &hits[i]);
+  }
+  t.remove = now_s() - t0;
+
+  chained_map_del(&m);
+  return t;
+}
+
+int main() {
+  static const int sizes[] = {1000, 100000, 10000000};
+
+  for (int s = 0; s < 3; s++) {
+    int n = sizes[s];
+    v2i* hits = malloc(sizeof(v2i) * n);
+    v2i* misses = malloc(sizeof(v2i) * n);
+    make_keys(hits, misses, n);
+
+    print_times("chained", n, bench_chained_map(hits, misses, n));
+    print_times("open", n, bench_map(hits, misses, n, false));
+    print_times("open, reserved", n, bench_map(hits, misses, n, true));
+    print_times("typed", n, bench_typed_map(hits, misses, n));
+    printf("\n");
+    fflush(stdout);
+
+    free(hits);
+    free(misses);
+  }
+
+  printf("world.chunks workload, %dx%d window, %d frames:\n", bench_window,
+         bench_window, bench_frames);
+  printf("  generic map %6.1f ns/op\n", bench_chunk_workload(false));
+  printf("  chunk_map   %6.1f ns/op\n", bench_chunk_workload(true));
+
+  return sink == 0;
+}
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include "map_chained.h"
+
+static const chained_entry invalid_entry = {
+  .key_idx = SIZE_MAX,
+  .val_idx = SIZE_MAX,
+  .next = NULL,
+};
+
+chained_entry* chained_map_internal_new_entries(size_t size) {
+  chained_entry* it = malloc(sizeof(chained_entry) * size);
+  for (int i = 0; i < size; i++) {
+    it[i] = invalid_entry;
+  }
+
+  return it;
+}
+
+bool chained_map_internal_entry_is_invalid(chained_entry* e) {
+  return e->key_idx == SIZE_MAX;
+}
+
+void chained_map_internal_insert_entry(chained_map* d, chained_entry* e) {
+  size_t insert_index = d->hash(arr_at(d->keys, e->key_idx)) % d->c_entries;
+
+  if (chained_map_internal_entry_is_invalid(&d->entries[insert_index])) {
+    d->entries[insert_index] = *e;
+  } else {
+    chained_entry* heap = malloc(sizeof(*e));
+    memcpy(heap, e, sizeof(*e));
+
+    chained_entry* end = &d->entries[insert_index];
+    while (end->next) {
+      end = end->next;
+    }
+
+    end->next = heap;
+  }
+
+  d->n_entries++;
+}
+
+void chained_map_add(chained_map* d, void* key, void* val) {
+  if (d->n_entries > d->c_entries * (long double)d->load_factor) {
+    chained_map new_d = {
+      .keys = d->keys,
+      .vals = d->vals,
+      .entries = chained_map_internal_new_entries(d->c_entries * 2),
+      .c_entries = d->c_entries * 2,
+      .n_entries = 0,
+      .eq = d->eq,
+      .hash = d->hash,
+      .load_factor = d->load_factor,
+      .key_size = d->key_size,
+      .val_size = d->val_size
+    };
+
+    for (int i = 0; i < d->c_entries; i++) {
+      chained_entry* e = &d->entries[i];
+      if (chained_map_internal_entry_is_invalid(e)) {
+        continue;
+      }
+
+      if (e->next) {
+        chained_entry* e1 = e->next;
+        while (e1) {
+          chained_entry to_insert = *e1;
+          to_insert.next = NULL;
+          chained_map_internal_insert_entry(&new_d, &to_insert);
+          chained_entry* to_free = e1;
+          e1 = e1->next;
+          free(to_free);
+        }
+      }
+
+      e->next = NULL;
+      chained_map_internal_insert_entry(&new_d, e);
+    }
+
+    chained_map_add(&new_d, key, val);
+    free(d->entries);
+    *d = new_d;
+
+    return;
+  }
+
+  arr_add(&d->keys, key);
+  arr_add(&d->vals, val);
+
+  chained_entry e = {
+    .key_idx = arr_len(d->keys) - 1,
+    .val_idx = arr_len(d->vals) - 1,
+    .next = NULL
+  };
+
+  chained_map_internal_insert_entry(d, &e);
+}
+
+void* chained_map_at(chained_map* d, void* key) {
+  size_t bucket_index = d->hash(key) % d->c_entries;
+  if (chained_map_internal_entry_is_invalid(&d->entries[bucket_index])) {
+    return NULL;
+  }
+
+  chained_entry* end = &d->entries[bucket_index];
+  while (end && !d->eq(key, arr_at(d->keys, end->key_idx))) {
+    end = end->next;
+  }
+
+  if (!end) {
+    return NULL;
+  }
+
+  return arr_at(d->vals, end->val_idx);
+}
+
+bool chained_map_has(chained_map* d, void* key) {
+  return chained_map_at(d, key) != NULL;
+}
+
+chained_entry* chained_map_internal_find_entry(chained_map* d, void* key) {
+  chained_entry* end = &d->entries[d->hash(key) % d->c_entries];
+  if (chained_map_internal_entry_is_invalid(end)) {
+    return NULL;
+  }
+
+  while (end && !d->eq(key, arr_at(d->keys, end->key_idx))) {
+    end = end->next;
+  }
+
+  return end;
+}
+
+bool chained_map_remove(chained_map* d, void* key) {
+  chained_entry* head = &d->entries[d->hash(key) % d->c_entries];
+  if (chained_map_internal_entry_is_invalid(head)) {
+    return false;
+  }
+
+  chained_entry* prev = NULL;
+  chained_entry* e = head;
+  while (e && !d->eq(key, arr_at(d->keys, e->key_idx))) {
+    prev = e;
+    e = e->next;
+  }
+
+  if (!e) {
+    return false;
+  }
+
+  size_t key_idx = e->key_idx, val_idx = e->val_idx;
+
+  // unlink; the bucket head lives in the table, the rest of the chain is heap
+  if (e == head) {
+    chained_entry* next = head->next;
+    if (next) {
+      *head = *next;
+      free(next);
+    } else {
+      *head = invalid_entry;
+    }
+  } else {
+    prev->next = e->next;
+    free(e);
+  }
+
+  d->n_entries--;
+
+  // keep keys and vals dense by moving the last pair into the hole
+  size_t last = arr_len(d->keys) - 1;
+  if (key_idx != last) {
+    chained_entry* moved =
+      chained_map_internal_find_entry(d, arr_at(d->keys, last));
+    memcpy(arr_at(d->keys, key_idx), arr_at(d->keys, last), d->key_size);
+    memcpy(arr_at(d->vals, val_idx), arr_at(d->vals, last), d->val_size);
+    moved->key_idx = key_idx;
+    moved->val_idx = val_idx;
+  }
+
+  arr_len(d->keys)--;
+  arr_len(d->vals)--;
+
+  return true;
+}
+
+chained_map
+chained_map_new(size_t initial_size, size_t key_size, size_t val_size,
+                float load_factor, bool (* eq)(void*, void*),
+                size_t (* hash)(void*)) {
+  return (chained_map){
+    .keys = internal_arr_new(initial_size, key_size, mem_here),
+    .vals = internal_arr_new(initial_size, val_size, mem_here),
+    .entries = chained_map_internal_new_entries(initial_size),
+    .c_entries = initial_size,
+    .n_entries = 0,
+    .load_factor = load_factor,
+    .eq = eq,
+    .hash = hash,
+    .key_size = key_size,
+    .val_size = val_size
+  };
+}
+
+
+void chained_map_del(chained_map* d) {
+  for (size_t i = 0; i < d->c_entries; i++) {
+    chained_entry* e = d->entries[i].next;
+    while (e) {
+      chained_entry* next = e->next;
+      free(e);
+      e = next;
+    }
+  }
+
+  free(d->entries);
+  arr_del(d->keys);
+  arr_del(d->vals);
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+
+// the separately chained map src/map.c used to be, kept as the baseline for
+// bench_map. renamed so it can link next to the current map.
+
+#include <assert.h>
+#include "../src/typedefs.h"
+#include "../src/arr.h"
+#include "../src/err.h"
+
+typedef struct chained_entry {
+  size_t key_idx;
+  size_t val_idx;
+  struct chained_entry* next;
+} chained_entry;
+
+typedef struct chained_map {
+  void* keys;
+  void* vals;
+  chained_entry* entries;
+  size_t c_entries, n_entries, key_size, val_size;
+  float load_factor;
+
+  bool (* eq)(void* lhs, void* rhs);
+
+  size_t (* hash)(void* key);
+} chained_map;
+
+chained_entry* chained_map_internal_new_entries(size_t size);
+
+chained_map
+chained_map_new(size_t initial_size, size_t key_size, size_t val_size,
+                float load_factor, bool(* eq)(void*, void*),
+                size_t(* hash)(void*));
+
+bool chained_map_internal_entry_is_invalid(chained_entry* e);
+
+void chained_map_internal_insert_entry(chained_map* d, chained_entry* e);
+
+void chained_map_add(chained_map* d, void* key, void* val);
+
+void* chained_map_at(chained_map* d, void* key);
+
+bool chained_map_has(chained_map* d, void* key);
+
+chained_entry* chained_map_internal_find_entry(chained_map* d, void* key);
+
+// swaps the last key/val into the removed slot, so pointers from
+// chained_map_at are invalidated. returns false if the key was not present.
+bool chained_map_remove(chained_map* d, void* key);
+
+void chained_map_del(chained_map* d);
\ No newline at end of file
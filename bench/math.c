@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/typedefs.h"
+
+/*-- the m4 kernels in typedefs.h against the scalar ones they replaced, in
+     millions of ops per second. --*/
+
+static double now_s() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// m4_mul, m4_tpose and m4_look before the simd kernels
+static m4f old_m4_tpose(m4f* orig) {
+  m4f out;
+  for (int i = 0; i < 4; i++) {
+    out.r[i] = (v4f){orig->v[0][i], orig->v[1][i], orig->v[2][i], orig->v[3][i]};
+  }
+
+  return out;
+}
+
+static m4f old_m4_mul(m4f lhs, m4f rhs) {
+  m4f out;
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 4; j++) {
+      out.v[i][j] = v4_dot(lhs.r[i], m4_col(&rhs, j));
+    }
+  }
+
+  return out;
+}
+
+static m4f old_m4_look(v3f pos, v3f dir, v3f up) {
+  v3f f = v3_normed(dir);
+  v3f s = v3_normed(v3_cross(f, up));
+  v3f u = v3_cross(s, f);
+
+  m4f out = {0};
+
+  out.v[0][0] = s.v[0];
+  out.v[0][1] = u.v[0];
+  out.v[0][2] = -f.v[0];
+  out.v[1][0] = s.v[1];
+  out.v[1][1] = u.v[1];
+  out.v[1][2] = -f.v[1];
+  out.v[2][0] = s.v[2];
+  out.v[2][1] = u.v[2];
+  out.v[2][2] = -f.v[2];
+  out.v[3][0] = -v3_dot(s, pos);
+  out.v[3][1] = -v3_dot(u, pos);
+  out.v[3][2] = v3_dot(f, pos);
+  out.v[0][3] = out.v[1][3] = out.v[2][3] = 0.0f;
+  out.v[3][3] = 1.0f;
+
+  return out;
+}
+
+// what callers wrote by hand before m4_transform_point
+static v3f old_m4_transform_point(m4f* m, v3f p) {
+  v4f h = {p.x, p.y, p.z, 1};
+  return (v3f){v4_dot(h, m4_col(m, 0)), v4_dot(h, m4_col(m, 1)),
+               v4_dot(h, m4_col(m, 2))};
+}
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ull;
+
+static float rng_float() {
+  uint64_t z = (rng_state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  z ^= z >> 31;
+  return (float)(z >> 40) / (float)(1 << 24) * 2 - 1;
+}
+
+// a random rigid transform times a perspective, like the matrices the
+// renderer builds. always invertible.
+static m4f random_m4() {
+  v3f axis = {rng_float(), rng_float(), rng_float() + 2};
+  m4f m = m4_mul(m4_rot(axis, rng_float() * 3),
+                 m4_trans(rng_float() * 100, rng_float() * 100, rng_float()));
+  return m4_mul(m, m4_persp(1.2f + rng_float() * 0.3f, 16.f / 9.f, 0.1f, 768.f));
+}
+
+#define bench_n_mats 1024
+#define bench_n_reps 4096
+
+static m4f mats[bench_n_mats];
+static v3f vecs[bench_n_mats];
+
+// times op over every matrix, bench_n_reps times over. the empty asm makes
+// every lane of each result be computed, so the old loops can not skip work
+// the simd kernels do anyway.
+#define bench_definition(name, op)                                             \
+static double name(void) {                                                     \
+  double t0 = now_s();                                                         \
+  for (int r = 0; r < bench_n_reps; r++) {                                     \
+    for (int i = 0; i < bench_n_mats; i++) {                                   \
+      m4f* m = &mats[i];                                                       \
+      v3f* p = &vecs[i];                                                       \
+      (void)m;                                                                 \
+      (void)p;                                                                 \
+      __auto_type out = (op);                                                  \
+      __asm__ volatile("" : : "m"(out));                                       \
+    }                                                                          \
+  }                                                                            \
+  double t = now_s() - t0;                                                     \
+                                                                               \
+  return (double)bench_n_mats * bench_n_reps / t * 1e-6;                       \
+}
+
+#define bench_next(i) mats[((i) + 1) & (bench_n_mats - 1)]
+
+bench_definition(bench_old_mul, old_m4_mul(*m, bench_next(i)))
+bench_definition(bench_new_mul, m4_mul(*m, bench_next(i)))
+bench_definition(bench_old_tpose, old_m4_tpose(m))
+bench_definition(bench_new_tpose, m4_tpose(m))
+bench_definition(bench_new_inv, m4_inv(m))
+bench_definition(bench_old_point, old_m4_transform_point(m, *p))
+bench_definition(bench_new_point, m4_transform_point(m, *p))
+bench_definition(bench_old_look,
+                 old_m4_look(*p, (v3f){p->z, 1, p->x}, (v3f){0, 1, 0}))
+bench_definition(bench_new_look,
+                 m4_look(*p, (v3f){p->z, 1, p->x}, (v3f){0, 1, 0}))
+
+static void report(char const* op, double (* old)(void), double (* new)(void)) {
+  double n = new();
+  if (old) {
+    double o = old();
+    printf("  %-10s %8.1f -> %8.1f  (%.2fx)\n", op, o, n, n / o);
+  } else {
+    printf("  %-10s %8s    %8.1f\n", op, "-", n);
+  }
+  fflush(stdout);
+}
+
+static float get_max_abs(m4f* m) {
+  float out = 0;
+  for (int i = 0; i < 16; i++) {
+    out = fmaxf(out, fabsf(m->v[i / 4][i % 4]));
+  }
+
+  return out;
+}
+
+static bool is_near(m4f* a, m4f* b, float eps) {
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 4; j++) {
+      if (fabsf(a->v[i][j] - b->v[i][j]) > eps) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+// the new kernels must give the old ones' bits, and m4_inv must invert
+static bool check() {
+  bool ok = true;
+
+  for (int i = 0; i < bench_n_mats; i++) {
+    m4f* a = &mats[i];
+    m4f* b = &bench_next(i);
+
+    m4f old = old_m4_mul(*a, *b), new = m4_mul(*a, *b);
+    if (memcmp(&old, &new, sizeof(m4f))) {
+      printf("m4_mul differs from the scalar one at %d\n", i);
+      ok = false;
+    }
+
+    old = old_m4_tpose(a), new = m4_tpose(a);
+    if (memcmp(&old, &new, sizeof(m4f))) {
+      printf("m4_tpose differs from the scalar one at %d\n", i);
+      ok = false;
+    }
+
+    v3f p = vecs[i], dir = {p.z, 1, p.x};
+    old = old_m4_look(p, dir, (v3f){0, 1, 0});
+    new = m4_look(p, dir, (v3f){0, 1, 0});
+    if (!is_near(&old, &new, 0)) {
+      printf("m4_look differs from the scalar one at %d\n", i);
+      ok = false;
+    }
+
+    // a perspective with a near plane of 0.1 is badly conditioned, so the
+    // error allowed grows with the size of the entries multiplied together
+    m4f inv = m4_inv(a);
+    m4f ident = m4_mul_p(a, &inv);
+    if (!is_near(&ident, (m4f*)&m4_ident,
+                 1e-6f * 4 * get_max_abs(a) * get_max_abs(&inv))) {
+      printf("m4 * m4_inv is not the identity at %d\n", i);
+      ok = false;
+    }
+
+    v3f q = m4_transform_point(a, p), old_q = old_m4_transform_point(a, p);
+    if (memcmp(&q, &old_q, sizeof(v3f))) {
+      printf("m4_transform_point differs from the scalar one at %d\n", i);
+      ok = false;
+    }
+  }
+
+  // a quarter turn about each axis, counter-clockwise looking down it
+  m4f rx = m4_rot_x(M_PI / 2), ry = m4_rot_y(M_PI / 2),
+    rz = m4_rot_z(M_PI / 2), ra = m4_rot((v3f){0, 0, 3}, M_PI / 2);
+  v3f x = m4_transform_vec(&rz, (v3f){1, 0, 0});
+  v3f y = m4_transform_vec(&rx, (v3f){0, 1, 0});
+  v3f z = m4_transform_vec(&ry, (v3f){0, 0, 1});
+  v3f a = m4_transform_vec(&ra, (v3f){1, 0, 0});
+  if (fabsf(x.y - 1) > 1e-6f || fabsf(y.z - 1) > 1e-6f ||
+      fabsf(z.x - 1) > 1e-6f || fabsf(a.y - 1) > 1e-6f) {
+    printf("a rotation turns the wrong way\n");
+    ok = false;
+  }
+
+  return ok;
+}
+
+int main() {
+  for (int i = 0; i < bench_n_mats; i++) {
+    mats[i] = random_m4();
+    vecs[i] = (v3f){rng_float() * 100, rng_float() * 100, rng_float() * 100};
+  }
+
+  if (!check()) {
+    return 1;
+  }
+
+  printf("m4 kernels (%s), millions of ops/s, old -> new:\n", m4_isa);
+  report("mul", bench_old_mul, bench_new_mul);
+  report("tpose", bench_old_tpose, bench_new_tpose);
+  report("inv", NULL, bench_new_inv);
+  report("point", bench_old_point, bench_new_point);
+  report("look", bench_old_look, bench_new_look);
+
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "../src/noise.h"
+
+/*-- scalar fnlGetNoise2D vs noise_grid_2d, in samples per second. --*/
+
+static double now_s() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// the grid a chunk samples: 17 x 17 points, one unit apart, scaled by 4
+static void fill_coords(float* c, int n, float origin) {
+  for (int i = 0; i < n; i++) {
+    c[i] = (origin + (float)i) * 4;
+  }
+}
+
+static void bench_state(char const* name, fnl_state s, int n, int reps) {
+  float* xs = malloc(sizeof(float) * n);
+  float* zs = malloc(sizeof(float) * n);
+  float* scalar = malloc(sizeof(float) * n * n);
+  float* batched = malloc(sizeof(float) * n * n);
+
+  double t0 = now_s();
+  for (int r = 0; r < reps; r++) {
+    fill_coords(xs, n, (float)(r * n));
+    fill_coords(zs, n, (float)(-r * n));
+    for (int i = 0; i < n; i++) {
+      for (int j = 0; j < n; j++) {
+        scalar[i * n + j] = fnlGetNoise2D(&s, xs[i], zs[j]);
+      }
+    }
+  }
+  double scalar_s = now_s() - t0;
+
+  t0 = now_s();
+  for (int r = 0; r < reps; r++) {
+    fill_coords(xs, n, (float)(r * n));
+    fill_coords(zs, n, (float)(-r * n));
+    noise_grid_2d(&s, xs, n, zs, n, batched);
+  }
+  double batched_s = now_s() - t0;
+
+  // both buffers hold the last rep
+  float max_err = 0;
+  for (int i = 0; i < n * n; i++) {
+    max_err = fmaxf(max_err, fabsf(scalar[i] - batched[i]));
+  }
+
+  double samples = (double)n * n * reps;
+  printf("%-14s %4dx%-4d scalar %8.2f Ms/s  batched %8.2f Ms/s  x%5.2f  "
+         "max err %g%s\n",
+         name, n, n, samples / scalar_s * 1e-6, samples / batched_s * 1e-6,
+         scalar_s / batched_s, max_err,
+         max_err <= noise_tolerance ? "" : "  (over tolerance!)");
+
+  free(xs);
+  free(zs);
+  free(scalar);
+  free(batched);
+}
+
+int main(int argc, char** argv) {
+  int reps = argc > 1 ? atoi(argv[1]) : 20000;
+
+  printf("noise_grid_2d isa: %s, %d lanes\n", noise_get_isa(), noise_lanes);
+
+  fnl_state simplex = fnlCreateState();
+
+  fnl_state fbm = fnlCreateState();
+  fbm.fractal_type = FNL_FRACTAL_FBM;
+  fbm.octaves = 4;
+  fbm.weighted_strength = 0.5f;
+
+  bench_state("opensimplex2", simplex, 17, reps);
+  bench_state("opensimplex2", simplex, 256, reps / 200 + 1);
+  bench_state("fbm x4", fbm, 17, reps / 4);
+  bench_state("fbm x4", fbm, 256, reps / 800 + 1);
+
+  return 0;
+}
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sched.h>
+#include "../src/terrain.h"
+#include "../src/pool.h"
+#include "../src/mem.h"
+
+/*-- chunk generation on a worker pool, the same work world_request_chunk
+ *   hands out, minus the upload. --*/
+
+static double now_s() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+typedef struct bench_job {
+  chunk_job job;
+
+  // seconds spent in chunk_job_run, on the worker
+  double build_s;
+} bench_job;
+
+static void bench_job_run(void* arg) {
+  bench_job* b = arg;
+
+  double t0 = now_s();
+  chunk_job_run(&b->job);
+  b->build_s = now_s() - t0;
+}
+
+static int double_cmp(void const* lhs, void const* rhs) {
+  double l = *(double const*)lhs, r = *(double const*)rhs;
+  return (l > r) - (l < r);
+}
+
+static double percentile(double* sorted, int n, double p) {
+  int i = (int)(p * (n - 1) + 0.5);
+  return sorted[i];
+}
+
+int main(int argc, char** argv) {
+  int n = argc > 1 ? atoi(argv[1]) : 64;
+  int n_threads = argc > 2 ? atoi(argv[2]) : 0;
+  if (n <= 0) {
+    fprintf(stderr, "usage: bench_world [region side in chunks] [threads]\n");
+    return 1;
+  }
+
+  pool* p = pool_new(n_threads);
+  int n_chunks = n * n;
+  bench_job* jobs = calloc(n_chunks, sizeof(bench_job));
+
+  // initializes the noise state outside the timed region
+  chunk_job warm = {.pos = {{-n, -n}}, .ys = chunk_new_grid(),
+                    .scratch = arena_new(chunk_job_arena_size)};
+  chunk_job_run(&warm);
+  mem_free(warm.ys);
+  arena_del(&warm.scratch);
+
+  double t0 = now_s();
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < n; j++) {
+      bench_job* b = &jobs[i * n + j];
+      b->job = (chunk_job){.pos = {{i - n / 2, j - n / 2}},
+                           .ys = chunk_new_grid(),
+                           .scratch = arena_new(chunk_job_arena_size)};
+      pool_push(p, (task){.run = bench_job_run, .arg = b});
+    }
+  }
+
+  task t;
+  for (int n_done = 0; n_done < n_chunks;) {
+    if (pool_pop_done(p, &t)) {
+      n_done++;
+    } else {
+      sched_yield();
+    }
+  }
+
+  double total_s = now_s() - t0;
+
+  double* build_s = malloc(sizeof(double) * n_chunks);
+  size_t n_vert_bytes = 0;
+  for (int i = 0; i < n_chunks; i++) {
+    build_s[i] = jobs[i].build_s;
+    n_vert_bytes += sizeof(chunk_vtx) * arr_len(jobs[i].job.verts);
+  }
+
+  qsort(build_s, n_chunks, sizeof(double), double_cmp);
+
+  // no grid sharing here, so every chunk samples its whole grid but the
+  // apron corners
+  double samples = (double)n_chunks * (chunk_n_heights - 4);
+
+  printf("%dx%d chunks on %d threads in %.3f s\n", n, n, p->n_threads,
+         total_s);
+  printf("  %10.1f chunks/s\n", n_chunks / total_s);
+  printf("  %10.2f M noise samples/s\n", samples / total_s * 1e-6);
+  printf("  %10zu bytes of vertex data per chunk\n",
+         n_vert_bytes / n_chunks);
+  printf("  build latency us: p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n",
+         percentile(build_s, n_chunks, 0.5) * 1e6,
+         percentile(build_s, n_chunks, 0.9) * 1e6,
+         percentile(build_s, n_chunks, 0.99) * 1e6,
+         build_s[n_chunks - 1] * 1e6);
+
+  pool_del(p, NULL);
+  for (int i = 0; i < n_chunks; i++) {
+    mem_free(jobs[i].job.ys);
+    arena_del(&jobs[i].job.scratch);
+  }
+
+  free(jobs);
+  free(build_s);
+  return 0;
+}
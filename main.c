@@ -1,6 +1,9 @@
 #include "src/app.h"
+#include "src/mem.h"
 
 int main() {
+  mem_dump_at_exit();
+
   app g = app_new(2304, 1440, "world");
   app_run(&g);
   app_cleanup(&g);
@@ -2,6 +2,7 @@
 #include "lib/glad/glad.h"
 #include "gl.h"
 #include "world.h"
+#include "mem.h"
 #include <time.h>
 #include <math.h>
 #include <sys/time.h>
@@ -59,6 +60,8 @@ app app_new(int width, int height, const char* name) {
     .post = vao_new(&post_vbo, NULL, 1, (attrib[]){attr_2f}),
     .cam = cam_new((v3f){0.f, 50.f, 0.f}, (v3f){0.f, 1.f, 0.f}, 225.f, -30.f,
                    (float)width / (float)height),
+    .frame_ubo = ubo_new(sizeof(frame_consts), frame_ubo_binding),
+    .draw_stream = draw_stream_new(app_max_model_draws),
     .main = fbo_new(2,
                     (fbo_spec[]){
                       {GL_COLOR_ATTACHMENT0, tex_spec_rgba8(width, height,
@@ -150,19 +153,45 @@ void app_tick(app* a) {
   }
 }
 
+// only the first few offending frames are printed; the rest are counted
+#define app_max_alloc_reports 8
+
+// a steady frame is one where the camera and window stayed put and the world
+// had no chunks in flight, so it should not have touched the heap. debug
+// builds report the allocation sites of any that did.
+static void app_check_frame_allocs(app* a, bool is_steady) {
+#ifndef NDEBUG
+  size_t n = mem_get_frame_allocs();
+  if (!is_steady || n == 0) {
+    return;
+  }
+
+  a->n_alloc_frames++;
+  if (a->n_alloc_frames <= app_max_alloc_reports) {
+    fprintf(stderr, "steady frame allocated %zu times:\n", n);
+    mem_dump_frame_sites(stderr);
+  }
+#endif
+}
+
 void app_run(app* a) {
   app_setup_user_ptr(a);
   gl_depth_func(GL_LESS);
   gl_clear_color(0.3f, 1.f, 1.f, 1.f);
-  gl_enable(GL_BLEND);
+  gl_state_enable(GL_BLEND);
   gl_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
   gl_debug_message_callback(gl_error_callback, NULL);
-  gl_enable(GL_DEBUG_OUTPUT);
-  gl_enable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+  gl_state_enable(GL_DEBUG_OUTPUT);
+  gl_state_enable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
 
   while (!glfw_window_should_close(a->win)) {
-    gl_enable(GL_DEPTH_TEST);
+    cam prev_cam = a->cam;
+    v2f prev_win_size = a->win_size;
+    bool was_settled = world_is_settled(&a->world);
+    mem_frame_begin();
+
+    gl_state_enable(GL_DEPTH_TEST);
 
     // draw the scene
     fbo_bind(&a->main);
@@ -171,10 +200,13 @@ void app_run(app* a) {
     app_tick(a);
 
     cam_rot(&a->cam, a->tick_delta);
+    frame_ubo_update(&a->frame_ubo, &a->cam, a->tick_delta);
+    stream_begin(&a->draw_stream);
     world_draw(&a->world, &a->cam, a->tick_delta);
+    stream_end(&a->draw_stream);
 
     if (a->is_rendering_halftone) {
-      gl_disable(GL_BLEND);
+      gl_state_disable(GL_BLEND);
 
       // convert to cmyk
       fbo_bind(&a->cmyk);
@@ -205,11 +237,11 @@ void app_run(app* a) {
       vao_bind(&a->post);
       gl_draw_arrays(GL_TRIANGLES, 0, 6);
 
-      gl_enable(GL_BLEND);
+      gl_state_enable(GL_BLEND);
 
       // draw dots on back-buffer
-      gl_bind_framebuffer(GL_FRAMEBUFFER, 0);
-      gl_disable(GL_DEPTH_TEST);
+      gl_state_bind_fbo(0);
+      gl_state_disable(GL_DEPTH_TEST);
       gl_clear(GL_COLOR_BUFFER_BIT);
 
       shader_bind(&a->dots);
@@ -224,8 +256,8 @@ void app_run(app* a) {
       vao_bind(&a->post);
       gl_draw_arrays(GL_TRIANGLES, 0, 6);
     } else {
-      gl_bind_framebuffer(GL_FRAMEBUFFER, 0);
-      gl_disable(GL_DEPTH_TEST);
+      gl_state_bind_fbo(0);
+      gl_state_disable(GL_DEPTH_TEST);
       gl_clear(GL_COLOR_BUFFER_BIT);
 
       shader_bind(&a->blit);
@@ -241,10 +273,25 @@ void app_run(app* a) {
 
     glfw_swap_buffers(a->win);
     glfw_poll_events();
+
+    bool is_still = v3_dist(a->cam.pos, prev_cam.pos) == 0.f &&
+                    a->cam.yaw == prev_cam.yaw &&
+                    a->cam.pitch == prev_cam.pitch &&
+                    v2_dist(a->win_size, prev_win_size) == 0.f;
+    app_check_frame_allocs(a, is_still && was_settled &&
+                              world_is_settled(&a->world));
   }
 }
 
 void app_cleanup(app* g) {
+  if (g->n_alloc_frames > 0) {
+    fprintf(stderr, "%d steady frames allocated\n", g->n_alloc_frames);
+  }
+
+  // before the window, and with it the context the world's buffers are in
+  world_del(&g->world);
+  buf_del(&g->frame_ubo);
+  stream_del(&g->draw_stream);
   glfw_destroy_window(g->win);
 }
 
@@ -262,7 +309,7 @@ void framebuffer_size_callback(GLFWwindow* win, int width, int height) {
   fbo_resize(&k->main, width, height, 2,
              (uint[]){GL_COLOR_ATTACHMENT0, GL_DEPTH_ATTACHMENT});
   k->cam.aspect = (float)width / (float)height;
-  gl_viewport(0, 0, width, height);
+  gl_state_viewport(0, 0, width, height);
 }
 
 void cursor_pos_callback(GLFWwindow* win, double xpos, double ypos) {
@@ -285,6 +332,24 @@ key_callback(GLFWwindow* win, int keycode, int scancode, int action, int mods) {
       g->is_rendering_halftone = !g->is_rendering_halftone;
       break;
     }
+    case GLFW_KEY_F: {
+      if (action != GLFW_PRESS) break;
+      g->world.is_flat_shaded = !g->world.is_flat_shaded;
+      break;
+    }
+    case GLFW_KEY_M: {
+      if (action != GLFW_PRESS) break;
+      mem_dump(stdout);
+      break;
+    }
+    case GLFW_KEY_G: {
+      if (action != GLFW_PRESS) break;
+      gl_state_dump(stdout);
+      stream_dump(&g->world.cmd_stream, "cmds", stdout);
+      stream_dump(&g->world.off_stream, "offs", stdout);
+      stream_dump(&g->draw_stream, "draws", stdout);
+      break;
+    }
   }
 }
 
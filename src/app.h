@@ -7,17 +7,30 @@
 #include "gl.h"
 #include "world.h"
 
+// models mod_draw can draw in a frame, which sizes draw_stream
+#define app_max_model_draws 256
+
 typedef struct app {
   v2f win_size;
   v2f mouse_pos;
   struct vao post;
   shader to_cmyk, dots, blur, blit;
   cam cam;
+
+  // the frame block every 3d shader reads the camera from
+  buf frame_ubo;
+
+  // a draw block per model drawn, see mod_draw
+  stream draw_stream;
+
   fbo cmyk, cmyk2, main;
   world world;
   bool is_mouse_captured, is_rendering_halftone;
   float tick_delta;
 
+  // steady frames that allocated anyway, see app_check_frame_allocs
+  int n_alloc_frames;
+
   // owning!
   GLFWwindow* win;
 } app;
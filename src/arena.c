@@ -0,0 +1,104 @@
+#include <stdlib.h>
+#include "arena.h"
+#include "mem.h"
+
+static size_t arena_round_up(size_t size) {
+  return (size + arena_align - 1) & ~(size_t)(arena_align - 1);
+}
+
+static arena_block* arena_new_block(size_t size, mem_site site) {
+  arena_block* b = mem_alloc_at(mem_tag_arena, sizeof(arena_block) + size,
+                                site);
+  *b = (arena_block){.next = NULL, .size = size, .used = 0};
+  return b;
+}
+
+arena arena_new(size_t block_size) {
+  return (arena){.block_size = block_size};
+}
+
+void* arena_alloc_at(arena* a, size_t size, mem_site site) {
+  size = arena_round_up(size);
+
+  // free blocks after cur are reused first; one too small for size is
+  // skipped and stays in the list for smaller allocations later
+  while (!a->cur || a->cur->used + size > a->cur->size) {
+    arena_block* next = a->cur ? a->cur->next : a->first;
+    if (!next) {
+      next = arena_new_block(max(size, a->block_size), site);
+      if (a->cur) {
+        a->cur->next = next;
+      } else {
+        a->first = next;
+      }
+    }
+
+    a->cur = next;
+    a->cur->used = 0;
+  }
+
+  void* ptr = a->cur->data + a->cur->used;
+  a->cur->used += size;
+  return ptr;
+}
+
+bool arena_extend(arena* a, void* ptr, size_t size, size_t new_size) {
+  size = arena_round_up(size);
+  new_size = arena_round_up(new_size);
+
+  arena_block* b = a->cur;
+  if (!b || (byte*)ptr + size != b->data + b->used ||
+      b->used - size + new_size > b->size) {
+    return false;
+  }
+
+  b->used = b->used - size + new_size;
+  return true;
+}
+
+arena_mark arena_get_mark(arena* a) {
+  return (arena_mark){.block = a->cur, .used = a->cur ? a->cur->used : 0};
+}
+
+void arena_rewind(arena* a, arena_mark m) {
+  a->cur = m.block;
+  if (a->cur) {
+    a->cur->used = m.used;
+  }
+}
+
+void arena_reset(arena* a) {
+  arena_rewind(a, (arena_mark){.block = a->first, .used = 0});
+}
+
+size_t arena_get_used(arena* a) {
+  size_t n = 0;
+  for (arena_block* b = a->first; b; b = b->next) {
+    n += b->used;
+    if (b == a->cur) {
+      break;
+    }
+  }
+
+  return n;
+}
+
+void arena_del(arena* a) {
+  for (arena_block* b = a->first; b;) {
+    arena_block* next = b->next;
+    mem_free(b);
+    b = next;
+  }
+
+  *a = (arena){};
+}
+
+// 64 KiB covers a shader source or a model's index list without a second
+// block; bigger requests get a block of their own
+#define arena_scratch_size (64 << 10)
+
+static _Thread_local arena scratch = {.block_size = arena_scratch_size};
+
+arena* arena_get_scratch() {
+  return &scratch;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "typedefs.h"
+#include "mem.h"
+
+/*-- bump allocation out of big blocks, freed all at once. --*/
+
+#define arena_align 16
+
+typedef struct arena_block arena_block;
+
+struct arena_block {
+  arena_block* next;
+  size_t size, used;
+
+  // every allocation is aligned to arena_align from here
+  _Alignas(arena_align) byte data[];
+};
+
+typedef struct arena {
+  // owning! blocks are kept after a reset or rewind and filled again, so an
+  // arena that is reused every frame or task stops calling malloc once it
+  // has seen its biggest frame or task.
+  arena_block* first;
+
+  // the block being bumped; every block after it is free
+  arena_block* cur;
+
+  // the size of new blocks, unless one allocation needs more
+  size_t block_size;
+} arena;
+
+// allocates nothing until the first arena_alloc
+arena arena_new(size_t block_size);
+
+// not zeroed. never fails; the arena grows a block if it has to.
+void* arena_alloc_at(arena* a, size_t size, mem_site site);
+
+#define arena_alloc(a, size) arena_alloc_at(a, size, mem_here)
+
+// if ptr is the last allocation, tries to grow it to new_size in place.
+// lets an arr on an arena grow without copying.
+bool arena_extend(arena* a, void* ptr, size_t size, size_t new_size);
+
+// a point to rewind back to, which frees everything allocated after it.
+// marks nest, like scopes:
+//   arena_mark m = arena_get_mark(a);
+//   ... arena_alloc(a, ...) ...
+//   arena_rewind(a, m);
+typedef struct arena_mark {
+  arena_block* block;
+  size_t used;
+} arena_mark;
+
+arena_mark arena_get_mark(arena* a);
+
+void arena_rewind(arena* a, arena_mark m);
+
+// frees every allocation, keeping the blocks
+void arena_reset(arena* a);
+
+size_t arena_get_used(arena* a);
+
+void arena_del(arena* a);
+
+// this thread's scratch arena, for buffers that do not outlive the function
+// using them. only use it between an arena_get_mark and an arena_rewind.
+arena* arena_get_scratch();
\ No newline at end of file
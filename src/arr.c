@@ -1,38 +1,65 @@
 #include <assert.h>
 #include "arr.h"
 #include "err.h"
+#include "mem.h"
 
-arr_metadata* internal_arr_get_metadata(byte* memory) {
-  return ((arr_metadata*)(memory - sizeof(arr_metadata)));
-}
-
-byte* internal_arr_new(size_t len, size_t elem_size) {
-  byte* memory = malloc(sizeof(arr_metadata) + len * elem_size);
+static byte* internal_arr_init(byte* memory, arena* a, size_t len,
+                               size_t elem_size) {
   memcpy(memory, &(arr_metadata){
     .len = len,
     .count = 0,
-    .elem_size = elem_size
+    .elem_size = elem_size,
+    .arena = a
   }, sizeof(arr_metadata));
 
   return memory + sizeof(arr_metadata);
 }
 
+byte* internal_arr_new(size_t len, size_t elem_size, mem_site site) {
+  byte* memory = mem_alloc_at(mem_tag_arr,
+                              sizeof(arr_metadata) + len * elem_size, site);
+  return internal_arr_init(memory, NULL, len, elem_size);
+}
+
+byte* internal_arr_new_in(arena* a, size_t len, size_t elem_size,
+                          mem_site site) {
+  byte* memory = arena_alloc_at(a, sizeof(arr_metadata) + len * elem_size,
+                                site);
+  return internal_arr_init(memory, a, len, elem_size);
+}
+
 byte* internal_arr_base_ptr(byte* memory) {
   return memory - sizeof(arr_metadata);
 }
 
-void arr_add(void* thing, void* item) {
+// gives memory room for len elements. arena arrs can not be realloc'd, so
+// they extend in place or move to a fresh allocation, leaving the old one
+// to the arena.
+static byte* internal_arr_grow(byte* memory, size_t len, mem_site site) {
+  arr_metadata* data = internal_arr_get_metadata(memory);
+  byte* base = internal_arr_base_ptr(memory);
+  size_t size = sizeof(arr_metadata) + data->len * data->elem_size;
+  size_t new_size = sizeof(arr_metadata) + len * data->elem_size;
+
+  if (!data->arena) {
+    base = mem_realloc_at(mem_tag_arr, base, new_size, site);
+  } else if (!arena_extend(data->arena, base, size, new_size)) {
+    byte* new_base = arena_alloc_at(data->arena, new_size, site);
+    memcpy(new_base, base,
+           sizeof(arr_metadata) + data->count * data->elem_size);
+    base = new_base;
+  }
+
+  ((arr_metadata*)base)->len = len;
+  return base + sizeof(arr_metadata);
+}
+
+void internal_arr_add(void* thing, void* item, mem_site site) {
   void** memory = thing;
   arr_metadata* data = internal_arr_get_metadata(*memory);
 
   if (data->len == data->count) {
-    data->len *= 2;
-    size_t new_size_in_bytes =
-      sizeof(arr_metadata) + data->len * data->elem_size;
-    byte* new_base_ptr = realloc(internal_arr_base_ptr(*memory),
-                                 new_size_in_bytes);
-    *memory = new_base_ptr + sizeof(arr_metadata);
-
+    *memory = internal_arr_grow(*memory, data->len * 2, site);
     data = internal_arr_get_metadata(*memory);
   }
 
@@ -40,6 +67,75 @@ void arr_add(void* thing, void* item) {
   data->count++;
 }
 
+void internal_arr_reserve(void* thing, size_t n, mem_site site) {
+  void** memory = thing;
+  if (n > internal_arr_get_metadata(*memory)->len) {
+    *memory = internal_arr_grow(*memory, n, site);
+  }
+}
+
+void internal_arr_resize(void* thing, size_t n, mem_site site) {
+  void** memory = thing;
+  internal_arr_reserve(memory, n, site);
+
+  arr_metadata* data = internal_arr_get_metadata(*memory);
+  if (n > data->count) {
+    memset(*memory + data->count * data->elem_size, 0,
+           (n - data->count) * data->elem_size);
+  }
+
+  data->count = n;
+}
+
+void internal_arr_add_n(void* thing, void* items, size_t n, mem_site site) {
+  void** memory = thing;
+  arr_metadata* data = internal_arr_get_metadata(*memory);
+
+  // doubling, not exact, so repeated arr_add_n stays amortized
+  if (data->count + n > data->len) {
+    size_t len = max(data->len, (size_t)1);
+    while (len < data->count + n) {
+      len *= 2;
+    }
+
+    *memory = internal_arr_grow(*memory, len, site);
+    data = internal_arr_get_metadata(*memory);
+  }
+
+  memcpy(*memory + data->count * data->elem_size, items, n * data->elem_size);
+  data->count += n;
+}
+
+void internal_arr_shrink_to_fit(void* thing, mem_site site) {
+  void** memory = thing;
+  arr_metadata* data = internal_arr_get_metadata(*memory);
+
+  size_t len = data->count;
+  if (len == data->len) {
+    return;
+  }
+
+  size_t size = sizeof(arr_metadata) + data->len * data->elem_size;
+  size_t new_size = sizeof(arr_metadata) + len * data->elem_size;
+  if (!data->arena) {
+    byte* base = mem_realloc_at(mem_tag_arr, internal_arr_base_ptr(*memory),
+                                new_size, site);
+    *memory = base + sizeof(arr_metadata);
+  } else if (!arena_extend(data->arena, internal_arr_base_ptr(*memory), size,
+                           new_size)) {
+    return;
+  }
+
+  internal_arr_get_metadata(*memory)->len = len;
+}
+
+void internal_arr_grow_one(void* thing, mem_site site) {
+  void** memory = thing;
+  // arr_new(T, 0) is fine, so len can be 0
+  size_t len = internal_arr_get_metadata(*memory)->len;
+  *memory = internal_arr_grow(*memory, max(len * 2, (size_t)1), site);
+}
+
 bool internal_arr_has(byte* memory, byte* element, size_t elem_size) {
   arr_metadata* data = internal_arr_get_metadata(memory);
 
@@ -58,8 +154,12 @@ bool internal_arr_has(byte* memory, byte* element, size_t elem_size) {
 }
 
 void internal_arr_del(byte* memory) {
+  if (internal_arr_get_metadata(memory)->arena) {
+    return;
+  }
+
   byte* base = internal_arr_base_ptr(memory);
-  free(base);
+  mem_free(base);
 }
 
 void* internal_arr_at(byte* memory, size_t n) {
@@ -72,7 +172,7 @@ void arr_clear(void* memory) {
   meta->count = 0;
 }
 
-void arr_add_bulk(void* thing, void* src) {
+void internal_arr_add_bulk(void* thing, void* src, mem_site site) {
   void** dst = thing;
   arr_metadata* dst_meta = internal_arr_get_metadata(*dst);
   arr_metadata* src_meta = internal_arr_get_metadata(src);
@@ -84,12 +184,7 @@ void arr_add_bulk(void* thing, void* src) {
   size_t new_count = dst_meta->count + src_meta->count;
   if (new_count > dst_meta->len) {
     size_t next = (size_t)pow(2, ceil(log2((double)new_count)));
-
-    void* new_memory = realloc(internal_arr_base_ptr(*dst),
-                               sizeof(arr_metadata) +
-                               next * dst_meta->elem_size);
-    *dst = new_memory + sizeof(arr_metadata);
-
+    *dst = internal_arr_grow(*dst, next, site);
     dst_meta = internal_arr_get_metadata(*dst);
   }
 
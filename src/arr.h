@@ -3,6 +3,8 @@
 #include <string.h>
 #include <stdint.h>
 #include "typedefs.h"
+#include "arena.h"
+#include "mem.h"
 
 typedef struct arr_metadata arr_metadata;
 
@@ -10,29 +12,86 @@ struct arr_metadata {
   size_t len;
   size_t count;
   size_t elem_size;
+
+  // NULL for arrs on the heap. an arr on an arena grows in place when it was
+  // the arena's last allocation, and is freed with the arena.
+  arena* arena;
 };
 
 typedef uint8_t byte;
 
-arr_metadata* internal_arr_get_metadata(byte* memory);
+// inline, so arr_len and the push macros below need no call
+inline static arr_metadata* internal_arr_get_metadata(byte* memory) {
+  return (arr_metadata*)(memory - sizeof(arr_metadata));
+}
+
+// every function that can allocate takes its caller's site, so mem's
+// per-frame report names the code using the arr
+byte* internal_arr_new(size_t len, size_t elem_size, mem_site site);
 
-byte* internal_arr_new(size_t len, size_t elem_size);
+byte* internal_arr_new_in(arena* a, size_t len, size_t elem_size,
+                          mem_site site);
 
 byte* internal_arr_base_ptr(byte* memory);
 
-#define arr_new(type, initial_size) (type*) internal_arr_new(initial_size, sizeof(type))
+#define arr_new(type, initial_size) (type*) internal_arr_new(initial_size, sizeof(type), mem_here)
+
+#define arr_new_in(a, type, initial_size) (type*) internal_arr_new_in(a, initial_size, sizeof(type), mem_here)
 
-void arr_add(void* memory, void* item);
+void internal_arr_add(void* memory, void* item, mem_site site);
+
+#define arr_add(memory, ...) internal_arr_add(memory, __VA_ARGS__, mem_here)
 
 bool internal_arr_has(byte* memory, byte* element, size_t elem_size);
 
 #define arr_has(this, element) internal_arr_has((byte*) this, (byte*) &element, sizeof(element))
 #define arr_has_i(this, type, ...) internal_arr_has((byte*) this, (byte*) &(type) {__VA_ARGS__}, sizeof(type))
 
-#define arr_last(this) &(this)[arr_count(this) - 1]
+#define arr_last(this) &(this)[arr_len(this) - 1]
 
 #define arr_len(this) internal_arr_get_metadata((byte*) this)->count
 
+// number of elements the arr can hold before it has to grow
+#define arr_cap(this) internal_arr_get_metadata((byte*) this)->len
+
+// makes room for at least n elements in total. never shrinks.
+void internal_arr_reserve(void* memory, size_t n, mem_site site);
+
+#define arr_reserve(memory, n) internal_arr_reserve(memory, n, mem_here)
+
+// sets the length to n, zeroing any new elements
+void internal_arr_resize(void* memory, size_t n, mem_site site);
+
+#define arr_resize(memory, n) internal_arr_resize(memory, n, mem_here)
+
+// appends n elements from items, which must not point into the arr
+void internal_arr_add_n(void* memory, void* items, size_t n, mem_site site);
+
+#define arr_add_n(memory, ...) internal_arr_add_n(memory, __VA_ARGS__, mem_here)
+
+// gives back the capacity past the length. an arr on an arena only shrinks
+// if it is the arena's last allocation.
+void internal_arr_shrink_to_fit(void* memory, mem_site site);
+
+#define arr_shrink_to_fit(memory) internal_arr_shrink_to_fit(memory, mem_here)
+
+// doubles the capacity; out of line so arr_push stays small
+void internal_arr_grow_one(void* memory, mem_site site);
+
+// typed appends, for when the element type is known: a length check and a
+// store, where arr_add is a call and a memcpy of elem_size bytes.
+//   arr_push(verts, (chunk_vtx){...});
+// this is evaluated more than once, so it should be a plain variable.
+#define arr_push(this, ...) \
+  ((void)(arr_len(this) == arr_cap(this) \
+            ? internal_arr_grow_one(&(this), mem_here) : (void)0), \
+   (this)[arr_len(this)++] = (__VA_ARGS__))
+
+// arr_push without the length check, after an arr_reserve
+#define arr_push_reserved(this, ...) \
+  ((this)[arr_len(this)++] = (__VA_ARGS__))
+
+// does nothing for an arr on an arena
 void internal_arr_del(byte* memory);
 
 #define arr_del(this) internal_arr_del((byte*) this)
@@ -43,7 +102,9 @@ void* internal_arr_at(byte* memory, size_t n);
 
 void arr_clear(void* memory);
 
-void arr_add_bulk(void* dst, void* src);
+void internal_arr_add_bulk(void* dst, void* src, mem_site site);
+
+#define arr_add_bulk(dst, src) internal_arr_add_bulk(dst, src, mem_here)
 
 void* arr_end(void* memory);
 
@@ -0,0 +1,190 @@
+#include <string.h>
+#include "batch.h"
+#include "cpu.h"
+
+// every helper taking or returning a vector is always inlined, so no vector
+// actually crosses a call boundary in the sse2 build
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+typedef float f32xn __attribute__((vector_size(batch_lanes * sizeof(float))));
+
+[[gnu::always_inline]]
+inline static f32xn batch_load(float const* p) {
+  f32xn out;
+  memcpy(&out, p, sizeof(out));
+  return out;
+}
+
+[[gnu::always_inline]]
+inline static void batch_store(float* p, f32xn v) {
+  memcpy(p, &v, sizeof(v));
+}
+
+// the kernels below are written once over a vector type T, and run on f32xn
+// for whole batches and on float for the tail. both see the same ops in the
+// same order, so the tail matches the lanes.
+
+#define batch_transform_point(T, m, x, y, z, ox, oy, oz) {                     \
+  T px = (x), py = (y), pz = (z);                                              \
+  (ox) = px * m->v[0][0] + py * m->v[1][0] + pz * m->v[2][0] + m->v[3][0];     \
+  (oy) = px * m->v[0][1] + py * m->v[1][1] + pz * m->v[2][1] + m->v[3][1];     \
+  (oz) = px * m->v[0][2] + py * m->v[1][2] + pz * m->v[2][2] + m->v[3][2];     \
+}
+
+[[gnu::always_inline]]
+inline static void
+batch_transform_lanes(m4f* m, v3_soa in, v3_soa out, int n) {
+  int i = 0;
+  for (; i + batch_lanes <= n; i += batch_lanes) {
+    f32xn ox, oy, oz;
+    batch_transform_point(f32xn, m, batch_load(in.x + i), batch_load(in.y + i),
+                          batch_load(in.z + i), ox, oy, oz);
+    batch_store(out.x + i, ox);
+    batch_store(out.y + i, oy);
+    batch_store(out.z + i, oz);
+  }
+
+  for (; i < n; i++) {
+    batch_transform_point(float, m, in.x[i], in.y[i], in.z[i], out.x[i],
+                          out.y[i], out.z[i]);
+  }
+}
+
+// the rows of the model matrix, quaternion to rotation matrix transposed for
+// row vectors, each row scaled by its axis's scale
+#define batch_compose_model(T, px, py, pz, qx, qy, qz, qw, sx, sy, sz, r) {    \
+  T xx = qx * qx, yy = qy * qy, zz = qz * qz;                                  \
+  T xy = qx * qy, xz = qx * qz, yz = qy * qz;                                  \
+  T wx = qw * qx, wy = qw * qy, wz = qw * qz;                                  \
+                                                                               \
+  r[0][0] = sx * (1 - 2 * (yy + zz));                                          \
+  r[0][1] = sx * (2 * (xy + wz));                                              \
+  r[0][2] = sx * (2 * (xz - wy));                                              \
+  r[1][0] = sy * (2 * (xy - wz));                                              \
+  r[1][1] = sy * (1 - 2 * (xx + zz));                                          \
+  r[1][2] = sy * (2 * (yz + wx));                                              \
+  r[2][0] = sz * (2 * (xz + wy));                                              \
+  r[2][1] = sz * (2 * (yz - wx));                                              \
+  r[2][2] = sz * (1 - 2 * (xx + yy));                                          \
+  r[3][0] = px;                                                                \
+  r[3][1] = py;                                                                \
+  r[3][2] = pz;                                                                \
+}
+
+[[gnu::always_inline]]
+inline static void
+batch_compose_lanes(v3_soa pos, v4_soa rot, v3_soa scale, m4f* out, int n) {
+  int i = 0;
+  for (; i + batch_lanes <= n; i += batch_lanes) {
+    f32xn r[4][3];
+    batch_compose_model(f32xn, batch_load(pos.x + i), batch_load(pos.y + i),
+                        batch_load(pos.z + i), batch_load(rot.x + i),
+                        batch_load(rot.y + i), batch_load(rot.z + i),
+                        batch_load(rot.w + i), batch_load(scale.x + i),
+                        batch_load(scale.y + i), batch_load(scale.z + i), r);
+
+    // back to one m4f per entity, which is what gets uploaded
+    for (int k = 0; k < batch_lanes; k++) {
+      out[i + k].r[0] = (v4f){r[0][0][k], r[0][1][k], r[0][2][k], 0};
+      out[i + k].r[1] = (v4f){r[1][0][k], r[1][1][k], r[1][2][k], 0};
+      out[i + k].r[2] = (v4f){r[2][0][k], r[2][1][k], r[2][2][k], 0};
+      out[i + k].r[3] = (v4f){r[3][0][k], r[3][1][k], r[3][2][k], 1};
+    }
+  }
+
+  for (; i < n; i++) {
+    float r[4][3];
+    batch_compose_model(float, pos.x[i], pos.y[i], pos.z[i], rot.x[i],
+                        rot.y[i], rot.z[i], rot.w[i], scale.x[i], scale.y[i],
+                        scale.z[i], r);
+
+    out[i].r[0] = (v4f){r[0][0], r[0][1], r[0][2], 0};
+    out[i].r[1] = (v4f){r[1][0], r[1][1], r[1][2], 0};
+    out[i].r[2] = (v4f){r[2][0], r[2][1], r[2][2], 0};
+    out[i].r[3] = (v4f){r[3][0], r[3][1], r[3][2], 1};
+  }
+}
+
+[[gnu::always_inline]]
+inline static void
+batch_lerp_lanes(v3_soa prev, v3_soa cur, float d, v3_soa out, int n) {
+  int i = 0;
+  for (; i + batch_lanes <= n; i += batch_lanes) {
+    f32xn px = batch_load(prev.x + i), py = batch_load(prev.y + i),
+      pz = batch_load(prev.z + i);
+
+    // v3_lerp's a + (b - a) * d
+    batch_store(out.x + i, px + (batch_load(cur.x + i) - px) * d);
+    batch_store(out.y + i, py + (batch_load(cur.y + i) - py) * d);
+    batch_store(out.z + i, pz + (batch_load(cur.z + i) - pz) * d);
+  }
+
+  for (; i < n; i++) {
+    out.x[i] = prev.x[i] + (cur.x[i] - prev.x[i]) * d;
+    out.y[i] = prev.y[i] + (cur.y[i] - prev.y[i]) * d;
+    out.z[i] = prev.z[i] + (cur.z[i] - prev.z[i]) * d;
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+[[gnu::target("avx2")]]
+static void batch_transform_avx2(m4f* m, v3_soa in, v3_soa out, int n) {
+  batch_transform_lanes(m, in, out, n);
+}
+
+[[gnu::target("avx2")]]
+static void batch_compose_avx2(v3_soa pos, v4_soa rot, v3_soa scale,
+                               m4f* out, int n) {
+  batch_compose_lanes(pos, rot, scale, out, n);
+}
+
+[[gnu::target("avx2")]]
+static void
+batch_lerp_avx2(v3_soa prev, v3_soa cur, float d, v3_soa out, int n) {
+  batch_lerp_lanes(prev, cur, d, out, n);
+}
+
+#endif
+
+char const* batch_get_isa() {
+#if defined(__x86_64__) || defined(__i386__)
+  return cpu_has_avx2() ? "avx2" : "sse2";
+#else
+  return "scalar";
+#endif
+}
+
+void batch_transform_points(m4f* m, v3_soa in, v3_soa out, int n) {
+#if defined(__x86_64__) || defined(__i386__)
+  if (cpu_has_avx2()) {
+    batch_transform_avx2(m, in, out, n);
+    return;
+  }
+#endif
+
+  batch_transform_lanes(m, in, out, n);
+}
+
+void batch_compose_models(v3_soa pos, v4_soa rot, v3_soa scale, m4f* out,
+                          int n) {
+#if defined(__x86_64__) || defined(__i386__)
+  if (cpu_has_avx2()) {
+    batch_compose_avx2(pos, rot, scale, out, n);
+    return;
+  }
+#endif
+
+  batch_compose_lanes(pos, rot, scale, out, n);
+}
+
+void batch_lerp(v3_soa prev, v3_soa cur, float d, v3_soa out, int n) {
+#if defined(__x86_64__) || defined(__i386__)
+  if (cpu_has_avx2()) {
+    batch_lerp_avx2(prev, cur, d, out, n);
+    return;
+  }
+#endif
+
+  batch_lerp_lanes(prev, cur, d, out, n);
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "typedefs.h"
+
+/*-- math over whole arrays of entities, batch_lanes at a time. --*/
+
+// lanes per batch. like noise.c, on x86 every kernel is built for avx2 and
+// for the baseline sse2, and picked once at runtime.
+#define batch_lanes 8
+
+// max abs difference from the single-value functions in typedefs.h. the
+// kernels do the same float ops in the same order, so results are normally
+// bit-identical; batch_compose_models has no scalar twin, and is checked
+// against m4_scale * m4_rot * m4_trans to this tolerance.
+#define batch_tolerance 1e-5f
+
+// n vectors as one array per component, so a batch of each is one load.
+// not owning; the arrays can be anywhere and need no alignment.
+typedef struct v3_soa {
+  float* x, * y, * z;
+} v3_soa;
+
+// rotations are unit quaternions, (x, y, z) = axis * sin(angle / 2) and
+// w = cos(angle / 2)
+typedef struct v4_soa {
+  float* x, * y, * z, * w;
+} v4_soa;
+
+// out[i] = m4_transform_point(m, in[i]). out may be in.
+void batch_transform_points(m4f* m, v3_soa in, v3_soa out, int n);
+
+// out[i] = m4_scale_v(scale[i]) * rotation of rot[i] * m4_trans_v(pos[i]),
+// the usual model matrix: scaled, then rotated, then moved, for row vectors.
+void batch_compose_models(v3_soa pos, v4_soa rot, v3_soa scale, m4f* out,
+                          int n);
+
+// out[i] = v3_lerp(prev[i], cur[i], d), like cam_get_pos between ticks.
+// out may be prev or cur.
+void batch_lerp(v3_soa prev, v3_soa cur, float d, v3_soa out, int n);
+
+// "avx2", "sse2" or "scalar"
+char const* batch_get_isa();
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include <stdlib.h>
+#include "cmap.h"
+#include "mem.h"
+
+static cmap_shard* cmap_get_shard(cmap* m, void* key) {
+  uint64_t hash = m->hash(key);
+  return &m->shards[hash >> (64 - __builtin_ctz(cmap_n_shards))];
+}
+
+// a zeroed value, from the free list or the last block. shard locked.
+static void* cmap_shard_new_val(cmap* m, cmap_shard* s) {
+  void* val;
+  if (!arr_is_empty(s->free_vals)) {
+    val = *arr_last(s->free_vals);
+    arr_len(s->free_vals)--;
+  } else {
+    if (arr_is_empty(s->blocks) || s->n_block_used == cmap_block_len) {
+      byte* block = mem_alloc(mem_tag_map, m->val_size * cmap_block_len);
+      arr_push(s->blocks, block);
+      s->n_block_used = 0;
+    }
+
+    val = *arr_last(s->blocks) + m->val_size * s->n_block_used++;
+  }
+
+  memset(val, 0, m->val_size);
+  return val;
+}
+
+cmap* cmap_new(size_t key_size, size_t val_size, bool (* eq)(void*, void*),
+               size_t (* hash)(void*)) {
+  cmap* m = mem_alloc(mem_tag_map, sizeof(cmap));
+  m->key_size = key_size;
+  m->val_size = val_size;
+  m->hash = hash;
+
+  // malloc only promises alignment for the basic types
+  m->shard_mem = mem_alloc(mem_tag_map, sizeof(cmap_shard) * cmap_n_shards +
+                                        cmap_line_size);
+  m->shards = (cmap_shard*)(((uintptr_t)m->shard_mem + cmap_line_size - 1) &
+                            ~(uintptr_t)(cmap_line_size - 1));
+
+  for (int i = 0; i < cmap_n_shards; i++) {
+    cmap_shard* s = &m->shards[i];
+    *s = (cmap_shard){
+      .vals = map_new(16, key_size, sizeof(void*), 0.75f, eq, hash),
+      .blocks = arr_new(byte*, 4),
+      .free_vals = arr_new(void*, 4),
+    };
+
+    if (pthread_rwlock_init(&s->lock, NULL)) {
+      throw_c("Failed to create a cmap lock!");
+    }
+  }
+
+  return m;
+}
+
+void* cmap_at(cmap* m, void* key) {
+  cmap_shard* s = cmap_get_shard(m, key);
+
+  pthread_rwlock_rdlock(&s->lock);
+  void** val = map_at(&s->vals, key);
+  void* out = val ? *val : NULL;
+  pthread_rwlock_unlock(&s->lock);
+
+  return out;
+}
+
+void* cmap_get_or_insert(cmap* m, void* key, bool* is_new) {
+  cmap_shard* s = cmap_get_shard(m, key);
+
+  // most calls find the key, and can share the shard with other readers
+  pthread_rwlock_rdlock(&s->lock);
+  void** val = map_at(&s->vals, key);
+  void* out = val ? *val : NULL;
+  pthread_rwlock_unlock(&s->lock);
+
+  if (out) {
+    *is_new = false;
+    return out;
+  }
+
+  // someone may have inserted it between the two locks
+  pthread_rwlock_wrlock(&s->lock);
+  val = map_get_or_insert(&s->vals, key, is_new);
+  if (*is_new) {
+    *val = cmap_shard_new_val(m, s);
+  }
+
+  out = *val;
+  pthread_rwlock_unlock(&s->lock);
+
+  return out;
+}
+
+bool cmap_remove(cmap* m, void* key) {
+  cmap_shard* s = cmap_get_shard(m, key);
+
+  pthread_rwlock_wrlock(&s->lock);
+  void** val = map_at(&s->vals, key);
+  bool has_key = val != NULL;
+  if (has_key) {
+    arr_push(s->free_vals, *val);
+    map_remove(&s->vals, key);
+  }
+
+  pthread_rwlock_unlock(&s->lock);
+
+  return has_key;
+}
+
+size_t cmap_get_size(cmap* m) {
+  size_t n = 0;
+  for (int i = 0; i < cmap_n_shards; i++) {
+    cmap_shard* s = &m->shards[i];
+    pthread_rwlock_rdlock(&s->lock);
+    n += s->vals.n_entries;
+    pthread_rwlock_unlock(&s->lock);
+  }
+
+  return n;
+}
+
+void cmap_del(cmap* m) {
+  for (int i = 0; i < cmap_n_shards; i++) {
+    cmap_shard* s = &m->shards[i];
+    for (size_t j = 0; j < arr_len(s->blocks); j++) {
+      mem_free(s->blocks[j]);
+    }
+
+    arr_del(s->blocks);
+    arr_del(s->free_vals);
+    map_del(&s->vals);
+    pthread_rwlock_destroy(&s->lock);
+  }
+
+  mem_free(m->shard_mem);
+  mem_free(m);
+}
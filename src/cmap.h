@@ -0,0 +1,63 @@
+#pragma once
+
+#include <pthread.h>
+#include "typedefs.h"
+#include "map.h"
+
+/*-- a map shared between threads, split into independently locked shards. --*/
+
+// a power of two. each key lives in the shard picked by the top bits of its
+// hash, which the shard's own table does not otherwise look at much.
+#define cmap_n_shards 64
+
+// values are carved out of blocks of this many, which never move
+#define cmap_block_len 64
+
+// shards are padded out to their own cache lines, so threads on different
+// shards do not bounce each other's lock
+#define cmap_line_size 64
+
+typedef struct cmap_shard {
+  // key --> value*, pointing into blocks
+  _Alignas(cmap_line_size) map vals;
+
+  // arr of owning! blocks of cmap_block_len values
+  byte** blocks;
+  size_t n_block_used;
+
+  // arr of removed values, reused before carving a new one
+  void** free_vals;
+
+  pthread_rwlock_t lock;
+} cmap_shard;
+
+typedef struct cmap {
+  // cmap_n_shards shards, aligned to cmap_line_size inside shard_mem
+  cmap_shard* shards;
+
+  // owning!
+  byte* shard_mem;
+
+  size_t key_size, val_size;
+  size_t (* hash)(void* key);
+} cmap;
+
+// owning!
+cmap* cmap_new(size_t key_size, size_t val_size, bool (* eq)(void*, void*),
+               size_t (* hash)(void*));
+
+// values keep their address until they are removed, however much the map
+// grows in the meantime. reading or writing through the address is up to the
+// caller to synchronize, and so is removing a key others may still be using.
+void* cmap_at(cmap* m, void* key);
+
+// inserts a zeroed value if key is not present. when several threads insert
+// the same key at once, exactly one of them sees is_new.
+void* cmap_get_or_insert(cmap* m, void* key, bool* is_new);
+
+bool cmap_remove(cmap* m, void* key);
+
+// a snapshot; other threads may change it right away
+size_t cmap_get_size(cmap* m);
+
+void cmap_del(cmap* m);
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+/*-- what the cpu supports, for the kernels that pick an isa at runtime. --*/
+
+// safe to call from any thread, pool workers included. libgcc fills in what
+// __builtin_cpu_supports reads from a constructor, before main, so there is
+// nothing to init here and no __builtin_cpu_init to race on; the atomic only
+// caches the answer.
+inline static bool cpu_has_avx2() {
+#if defined(__x86_64__) || defined(__i386__)
+  static _Atomic int has_avx2 = -1;
+
+  int out = atomic_load_explicit(&has_avx2, memory_order_relaxed);
+  if (out < 0) {
+    out = __builtin_cpu_supports("avx2") != 0;
+    atomic_store_explicit(&has_avx2, out, memory_order_relaxed);
+  }
+
+  return out;
+#else
+  return false;
+#endif
+}
\ No newline at end of file
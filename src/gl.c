@@ -2,6 +2,7 @@
 #include "err.h"
 #include "app.h"
 #include "arr.h"
+#include "mem.h"
 
 cam
 cam_new(v3f pos, v3f world_up, float yaw, float pitch, float aspect) {
@@ -44,7 +45,184 @@ m4f cam_get_look(cam* c, float d) {
 }
 
 m4f cam_get_proj(cam* c) {
-  return m4_persp(rad(c->zoom), c->aspect, 0.01f, 128.f);
+  // far enough for the world's whole draw distance
+  return m4_persp(rad(c->zoom), c->aspect, 0.1f, 768.f);
+}
+
+frustum cam_get_frustum(cam* c, float d) {
+  return frustum_new(m4_mul(cam_get_look(c, d), cam_get_proj(c)));
+}
+
+/*-- gl state cache --*/
+
+// no call has set it yet, so the first one always goes through
+#define gl_state_unknown UINT32_MAX
+
+static const uint gl_state_caps[] = {
+  GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_SCISSOR_TEST
+};
+
+#define gl_state_n_caps (sizeof(gl_state_caps) / sizeof(*gl_state_caps))
+
+static struct {
+  uint program, vao, fbo;
+  uint texes[gl_state_n_units];
+
+  // 1 on, 0 off, -1 unknown, in gl_state_caps' order
+  int8_t caps[gl_state_n_caps];
+  int viewport[4];
+
+  gl_state_stats stats[gl_state_n_kinds];
+} state = {
+  .program = gl_state_unknown,
+  .vao = gl_state_unknown,
+  .fbo = gl_state_unknown,
+  .texes = {[0 ... gl_state_n_units - 1] = gl_state_unknown},
+  .caps = {[0 ... gl_state_n_caps - 1] = -1},
+  .viewport = {-1, -1, -1, -1}
+};
+
+static char const* kind_names[gl_state_n_kinds] = {
+  [gl_state_kind_program] = "program",
+  [gl_state_kind_vao] = "vao",
+  [gl_state_kind_fbo] = "fbo",
+  [gl_state_kind_tex] = "tex",
+  [gl_state_kind_cap] = "cap",
+  [gl_state_kind_viewport] = "viewport",
+};
+
+// true if the call has to go through to gl. counted either way
+static bool gl_state_set(gl_state_kind kind, uint* shadow, uint val) {
+  if (*shadow == val) {
+    state.stats[kind].n_elided++;
+    return false;
+  }
+
+  *shadow = val;
+  state.stats[kind].n_issued++;
+  return true;
+}
+
+static int8_t* gl_state_find_cap(uint cap) {
+  for (size_t i = 0; i < gl_state_n_caps; i++) {
+    if (gl_state_caps[i] == cap) {
+      return &state.caps[i];
+    }
+  }
+
+  return NULL;
+}
+
+static bool gl_state_set_cap(uint cap, int8_t val) {
+  int8_t* shadow = gl_state_find_cap(cap);
+  if (shadow && *shadow == val) {
+    state.stats[gl_state_kind_cap].n_elided++;
+    return false;
+  }
+
+  if (shadow) {
+    *shadow = val;
+  }
+
+  state.stats[gl_state_kind_cap].n_issued++;
+  return true;
+}
+
+void gl_state_enable(uint cap) {
+  if (gl_state_set_cap(cap, 1)) {
+    gl_enable(cap);
+  }
+}
+
+void gl_state_disable(uint cap) {
+  if (gl_state_set_cap(cap, 0)) {
+    gl_disable(cap);
+  }
+}
+
+void gl_state_viewport(int x, int y, int width, int height) {
+  int* v = state.viewport;
+  if (v[0] == x && v[1] == y && v[2] == width && v[3] == height) {
+    state.stats[gl_state_kind_viewport].n_elided++;
+    return;
+  }
+
+  v[0] = x, v[1] = y, v[2] = width, v[3] = height;
+  state.stats[gl_state_kind_viewport].n_issued++;
+  gl_viewport(x, y, width, height);
+}
+
+void gl_state_use_program(uint id) {
+  if (gl_state_set(gl_state_kind_program, &state.program, id)) {
+    gl_use_program(id);
+  }
+}
+
+void gl_state_bind_vao(uint id) {
+  if (gl_state_set(gl_state_kind_vao, &state.vao, id)) {
+    gl_bind_vertex_array(id);
+  }
+}
+
+void gl_state_bind_fbo(uint id) {
+  if (gl_state_set(gl_state_kind_fbo, &state.fbo, id)) {
+    gl_bind_framebuffer(GL_FRAMEBUFFER, id);
+  }
+}
+
+void gl_state_bind_tex(uint unit, uint id) {
+  if (gl_state_set(gl_state_kind_tex, &state.texes[unit], id)) {
+    gl_bind_texture_unit(unit, id);
+  }
+}
+
+// a deleted program stays in use until another is, so it is only forgotten;
+// deleted vaos and textures are unbound by gl, which leaves 0 bound
+void gl_state_forget_program(uint id) {
+  if (state.program == id) {
+    state.program = gl_state_unknown;
+  }
+}
+
+void gl_state_forget_vao(uint id) {
+  if (state.vao == id) {
+    state.vao = 0;
+  }
+}
+
+void gl_state_forget_tex(uint id) {
+  for (int i = 0; i < gl_state_n_units; i++) {
+    if (state.texes[i] == id) {
+      state.texes[i] = 0;
+    }
+  }
+}
+
+gl_state_stats gl_state_get_stats(gl_state_kind kind) {
+  return state.stats[kind];
+}
+
+char const* gl_state_get_kind_name(gl_state_kind kind) {
+  return kind_names[kind];
+}
+
+void gl_state_dump(FILE* f) {
+  fprintf(f, "%-8s %12s %12s %8s\n", "state", "issued", "elided", "elided%");
+
+  gl_state_stats total = {0};
+  for (int i = 0; i < gl_state_n_kinds; i++) {
+    gl_state_stats s = state.stats[i];
+    size_t n = s.n_issued + s.n_elided;
+    fprintf(f, "%-8s %12zu %12zu %8.1f\n", kind_names[i], s.n_issued,
+            s.n_elided, n ? 100. * s.n_elided / n : 0.);
+
+    total.n_issued += s.n_issued;
+    total.n_elided += s.n_elided;
+  }
+
+  size_t n = total.n_issued + total.n_elided;
+  fprintf(f, "%-8s %12zu %12zu %8.1f\n", "total", total.n_issued,
+          total.n_elided, n ? 100. * total.n_elided / n : 0.);
 }
 
 void shader_verify(uint gl_id) {
@@ -63,19 +241,25 @@ uint shader_compile(shader_spec s) {
     throw_c("Failed to open file for shader_component!");
   }
 
-  char* src = calloc(1 << 20, 1);
-  char block[64];
-  while (fgets(block, sizeof(block), f)) {
-    strcat(src, block);
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  if (size < 0) {
+    throw_c("Failed to get the size of file for shader_component!");
   }
 
+  // text mode may read back fewer bytes than the file's size, never more
+  arena* scratch = arena_get_scratch();
+  arena_mark mark = arena_get_mark(scratch);
+  char* src = arena_alloc(scratch, size);
+  size_t len = fread(src, 1, size, f);
+
   uint gl_id = gl_create_shader(s.type);
-  gl_shader_source(gl_id, 1, (char const* []){src},
-                   (int[]){(int)strlen(src)});
+  gl_shader_source(gl_id, 1, (char const* []){src}, (int[]){(int)len});
   gl_compile_shader(gl_id);
   shader_verify(gl_id);
 
-  free(src);
+  arena_rewind(scratch, mark);
   fclose(f);
 
   return gl_id;
@@ -91,6 +275,42 @@ void prog_verify(uint gl_id) {
   }
 }
 
+static void shader_add_uniform(shader* s, char const* n, int len, uniform u) {
+  char* key = mem_alloc(mem_tag_gl, len + 1);
+  memcpy(key, n, len);
+  key[len] = '\0';
+
+  uniform_map_add(&s->uniforms, key, u);
+}
+
+// every active uniform outside a uniform block. an array is listed once, as
+// "name[0]", so it also goes in under the bare name, the same as
+// gl_get_uniform_location accepts.
+static void shader_reflect(shader* s) {
+  int n, max_len;
+  gl_get_programiv(s->id, GL_ACTIVE_UNIFORMS, &n);
+  gl_get_programiv(s->id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_len);
+
+  s->uniforms = uniform_map_new(2 * n, 0);
+
+  char name[max_len + 1];
+  for (int i = 0; i < n; i++) {
+    int len, size;
+    uint type;
+    gl_get_active_uniform(s->id, i, max_len + 1, &len, &size, &type, name);
+
+    uniform u = gl_get_uniform_location(s->id, name);
+    if (u < 0) {
+      continue;
+    }
+
+    shader_add_uniform(s, name, len, u);
+    if (len > 3 && !strcmp(name + len - 3, "[0]")) {
+      shader_add_uniform(s, name, len - 3, u);
+    }
+  }
+}
+
 shader shader_new(uint n, shader_spec* shaders) {
   uint gl_ids[n], gl_id = gl_create_program();
 
@@ -102,7 +322,9 @@ shader shader_new(uint n, shader_spec* shaders) {
   gl_link_program(gl_id);
   prog_verify(gl_id);
 
-  return (shader){.id = gl_id};
+  shader s = {.id = gl_id};
+  shader_reflect(&s);
+  return s;
 }
 
 struct vao vao_new(buf* vbo, buf* ibo, uint n, attrib* attrs) {
@@ -153,47 +375,237 @@ void buf_data(buf* b, uint usage, ssize_t size_in_bytes, void* data) {
   gl_named_buffer_data(b->id, size_in_bytes, data, usage);
 }
 
+void buf_storage(buf* b, ssize_t size_in_bytes, void* data, uint flags) {
+  gl_named_buffer_storage(b->id, size_in_bytes, data, flags);
+}
+
+void buf_sub_data(buf* b, ssize_t offset, ssize_t size_in_bytes, void* data) {
+  gl_named_buffer_sub_data(b->id, offset, size_in_bytes, data);
+}
+
 void shader_bind(shader* s) {
-  gl_use_program(s->id);
+  gl_state_use_program(s->id);
+}
+
+void shader_del(shader* s) {
+  gl_state_forget_program(s->id);
+
+  for (size_t i = 0; i < s->uniforms.n_entries; i++) {
+    mem_free((void*)s->uniforms.keys[i]);
+  }
+
+  uniform_map_del(&s->uniforms);
+  gl_delete_program(s->id);
+  s->id = 0;
+}
+
+uniform shader_get_uniform(shader* s, char const* n) {
+  uniform* u = uniform_map_at(&s->uniforms, n);
+  if (u) {
+    return *u;
+  }
+
+  // only names reflection did not list get here, like array elements past
+  // [0] or uniforms the compiler dropped. gl is asked once, and the answer,
+  // even -1, is kept.
+  uniform loc = gl_get_uniform_location(s->id, n);
+  shader_add_uniform(s, n, (int)strlen(n), loc);
+  return loc;
 }
 
 void vao_bind(struct vao* v) {
-  gl_bind_vertex_array(v->id);
+  gl_state_bind_vao(v->id);
+}
+
+buf ubo_new(ssize_t size, uint binding) {
+  buf b = buf_new(GL_UNIFORM_BUFFER);
+  buf_storage(&b, size, NULL, GL_DYNAMIC_STORAGE_BIT);
+  buf_bind_base(&b, binding);
+
+  return b;
+}
+
+void frame_ubo_update(buf* b, cam* c, float d) {
+  v3f eye = cam_get_pos(c, d);
+
+  frame_consts f = {
+    .proj = cam_get_proj(c),
+    .look = cam_get_look(c, d),
+    .eye = {eye.x, eye.y, eye.z, 1}
+  };
+
+  buf_sub_data(b, 0, sizeof(f), &f);
+}
+
+static ssize_t stream_get_align() {
+  int ubo_align = 0, ssbo_align = 0;
+  gl_get_integerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &ubo_align);
+  gl_get_integerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &ssbo_align);
+
+  // indirect commands only need 4, but vec4s and matrices like 16
+  ssize_t align = max(16, max(ubo_align, ssbo_align));
+  if (align & (align - 1)) {
+    throw_c("Buffer offset alignment is not a power of two!");
+  }
+
+  return align;
+}
+
+stream stream_new(uint type, ssize_t region_size) {
+  const uint flags =
+    GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+  stream s = {.buf = buf_new(type), .align = stream_get_align()};
+  s.region_size = (region_size + s.align - 1) & ~(s.align - 1);
+
+  ssize_t size = s.region_size * stream_n_frames;
+  buf_storage(&s.buf, size, NULL, flags);
+  s.mapped = gl_map_named_buffer_range(s.buf.id, 0, size, flags);
+  if (!s.mapped) {
+    throw_c("Failed to map a stream!");
+  }
+
+  // so the first stream_begin lands on region 0
+  s.region = stream_n_frames - 1;
+  return s;
+}
+
+static void stream_wait(stream* s, int region) {
+  GLsync fence = s->fences[region];
+  if (!fence) {
+    return;
+  }
+
+  uint status = gl_client_wait_sync(fence, 0, 0);
+  if (status == GL_TIMEOUT_EXPIRED) {
+    s->n_stalls++;
+
+    // a second at a time; the flush makes sure the fence gets to the gpu
+    do {
+      status = gl_client_wait_sync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                   1000000000);
+    } while (status == GL_TIMEOUT_EXPIRED);
+  }
+
+  if (status == GL_WAIT_FAILED) {
+    throw_c("Failed to wait for a stream's fence!");
+  }
+
+  gl_delete_sync(fence);
+  s->fences[region] = NULL;
+}
+
+void stream_begin(stream* s) {
+  s->region = (s->region + 1) % stream_n_frames;
+  s->used = 0;
+  stream_wait(s, s->region);
+}
+
+void* stream_alloc(stream* s, ssize_t size, ssize_t* offset) {
+  if (size > s->region_size - s->used) {
+    throw_c("Stream region is full!");
+  }
+
+  *offset = s->region * s->region_size + s->used;
+  s->used += (size + s->align - 1) & ~(s->align - 1);
+
+  return s->mapped + *offset;
+}
+
+void stream_end(stream* s) {
+  s->fences[s->region] = gl_fence_sync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void stream_del(stream* s) {
+  for (int i = 0; i < stream_n_frames; i++) {
+    stream_wait(s, i);
+  }
+
+  gl_unmap_named_buffer(s->buf.id);
+  buf_del(&s->buf);
+  s->mapped = NULL;
+}
+
+void stream_dump(stream* s, char const* name, FILE* f) {
+  fprintf(f, "%-8s %d x %zd bytes, %zu stalls\n", name, stream_n_frames,
+          s->region_size, s->n_stalls);
+}
+
+stream draw_stream_new(int max_draws) {
+  ssize_t align = stream_get_align();
+  ssize_t size = ((ssize_t)sizeof(draw_consts) + align - 1) & ~(align - 1);
+  return stream_new(GL_UNIFORM_BUFFER, size * max_draws);
 }
 
 void buf_bind(buf* b) {
   gl_bind_buffer(b->type, b->id);
 }
 
+void buf_bind_base(buf* b, uint index) {
+  gl_bind_buffer_base(b->type, index, b->id);
+}
+
+void buf_bind_range(buf* b, uint index, ssize_t offset, ssize_t size) {
+  gl_bind_buffer_range(b->type, index, b->id, offset, size);
+}
+
+void buf_del(buf* b) {
+  gl_delete_buffers(1, &b->id);
+  b->id = 0;
+}
+
+void vao_del(struct vao* v) {
+  gl_state_forget_vao(v->id);
+  gl_delete_vertex_arrays(1, &v->id);
+  v->id = 0;
+}
+
+void shader_mat4_at(shader* s, uniform u, m4f m) {
+  gl_program_uniform_matrix_4fv(s->id, u, 1, GL_TRUE, &m.v[0][0]);
+}
+
+void shader_int_at(shader* s, uniform u, int m) {
+  gl_program_uniform_1i(s->id, u, m);
+}
+
+void shader_float_at(shader* s, uniform u, float m) {
+  gl_program_uniform_1f(s->id, u, m);
+}
+
+void shader_vec2_at(shader* s, uniform u, v2f m) {
+  gl_program_uniform_2f(s->id, u, m.x, m.y);
+}
+
+void shader_vec3_at(shader* s, uniform u, v3f m) {
+  gl_program_uniform_3f(s->id, u, m.x, m.y, m.z);
+}
+
+void shader_vec4_at(shader* s, uniform u, v4f m) {
+  gl_program_uniform_4f(s->id, u, m.x, m.y, m.z, m.w);
+}
+
 void shader_mat4(shader* s, char const* n, m4f m) {
-  shader_bind(s);
-  gl_uniform_matrix_4fv(gl_get_uniform_location(s->id, n), 1, GL_TRUE,
-                        &m.v[0][0]);
+  shader_mat4_at(s, shader_get_uniform(s, n), m);
 }
 
 void shader_int(shader* s, char const* n, int m) {
-  shader_bind(s);
-  gl_uniform_1i(gl_get_uniform_location(s->id, n), m);
+  shader_int_at(s, shader_get_uniform(s, n), m);
 }
 
 void shader_float(shader* s, char const* n, float m) {
-  shader_bind(s);
-  gl_uniform_1f(gl_get_uniform_location(s->id, n), m);
+  shader_float_at(s, shader_get_uniform(s, n), m);
 }
 
 void shader_vec2(shader* s, char const* n, v2f m) {
-  shader_bind(s);
-  gl_uniform_2f(gl_get_uniform_location(s->id, n), m.x, m.y);
+  shader_vec2_at(s, shader_get_uniform(s, n), m);
 }
 
 void shader_vec3(shader* s, char const* n, v3f m) {
-  shader_bind(s);
-  gl_uniform_3f(gl_get_uniform_location(s->id, n), m.x, m.y, m.z);
+  shader_vec3_at(s, shader_get_uniform(s, n), m);
 }
 
 void shader_vec4(shader* s, char const* n, v4f m) {
-  shader_bind(s);
-  gl_uniform_4f(gl_get_uniform_location(s->id, n), m.x, m.y, m.z, m.w);
+  shader_vec4_at(s, shader_get_uniform(s, n), m);
 }
 
 int attrib_get_size_in_bytes(attrib* attr) {
@@ -274,17 +686,18 @@ void tex_resize(tex* t, int width, int height) {
   resized_spec.width = width, resized_spec.height = height;
   tex resized = tex_new(resized_spec);
 
+  gl_state_forget_tex(t->id);
   gl_delete_textures(1, &t->id);
   *t = resized;
 }
 
 void tex_bind(tex* t, uint unit) {
-  if (unit >= 16) throw_c("Unit too high!");
-  gl_active_texture(unit + GL_TEXTURE0);
-  gl_bind_texture(GL_TEXTURE_2D, t->id);
+  if (unit >= gl_state_n_units) throw_c("Unit too high!");
+  gl_state_bind_tex(unit, t->id);
 }
 
 void tex_del(tex* t) {
+  gl_state_forget_tex(t->id);
   gl_delete_textures(1, &t->id);
   if (t->spec.pixels) {
     free(t->spec.pixels);
@@ -293,8 +706,8 @@ void tex_del(tex* t) {
 }
 
 fbo fbo_new(uint n, fbo_spec* spec) {
-  fbo f = {.id = 0, .bufs = malloc(
-    n * sizeof(fbo_buf)), .n_bufs = n};
+  fbo f = {.id = 0, .bufs = mem_alloc(mem_tag_gl, n * sizeof(fbo_buf)),
+    .n_bufs = n};
   gl_create_framebuffers(1, &f.id);
   for (int i = 0; i < n; i++) {
     fbo_spec s = spec[i];
@@ -307,7 +720,7 @@ fbo fbo_new(uint n, fbo_spec* spec) {
 }
 
 void fbo_bind(fbo* f) {
-  gl_bind_framebuffer(GL_FRAMEBUFFER, f->id);
+  gl_state_bind_fbo(f->id);
 }
 
 void fbo_draw_bufs(fbo* f, int n, uint* bufs) {
@@ -405,7 +818,8 @@ void blur_up(shader* s, blur args) {
 
 mesh
 mod_load_mesh(mod* m, struct aiMesh* mesh, const struct aiScene* scene) {
-  mod_vtx* vtxs = malloc(sizeof(mod_vtx) * mesh->mNumVertices);
+  mod_vtx* vtxs = mem_alloc(mem_tag_model,
+                             sizeof(mod_vtx) * mesh->mNumVertices);
 
   for (int i = 0; i < mesh->mNumVertices; i++) {
     v3f pos = *(v3f*)&mesh->mVertices[i], norm = *(v3f*)&mesh->mNormals[i];
@@ -425,11 +839,12 @@ mod_load_mesh(mod* m, struct aiMesh* mesh, const struct aiScene* scene) {
              mesh->mNumVertices,
              vtxs);
 
-  uint* inds = arr_new(uint, 4);
+  // triangulated, so almost always exactly 3 indices a face
+  arena* scratch = arena_get_scratch();
+  arena_mark mark = arena_get_mark(scratch);
+  uint* inds = arr_new_in(scratch, uint, max(mesh->mNumFaces * 3, 1u));
   for (int i = 0; i < mesh->mNumFaces; i++) {
-    for (int j = 0; j < mesh->mFaces[i].mNumIndices; j++) {
-      arr_add(&inds, &mesh->mFaces[i].mIndices[j]);
-    }
+    arr_add_n(&inds, mesh->mFaces[i].mIndices, mesh->mFaces[i].mNumIndices);
   }
 
   buf_data_n(&ibo,
@@ -446,7 +861,7 @@ mod_load_mesh(mod* m, struct aiMesh* mesh, const struct aiScene* scene) {
                    (attrib[]){attr_3f, attr_3f, attr_2f})
   };
 
-  arr_del(inds);
+  arena_rewind(scratch, mark);
 
   return me;
 }
@@ -474,7 +889,7 @@ mod mod_new(const char* path) {
   }
 
   mod m = {
-    .meshes = malloc(sizeof(mesh) * scene->mNumMeshes)
+    .meshes = mem_alloc(mem_tag_model, sizeof(mesh) * scene->mNumMeshes)
   };
 
   mod_load(&m, scene->mRootNode, scene);
@@ -482,30 +897,31 @@ mod mod_new(const char* path) {
   return m;
 }
 
-void mod_draw(mod* m, cam* c, m4f t, float d) {
-  for (int i = 0; i < m->n_meshes; i++) {
-    (void)mod_get_shader(c, t, d);
+void mod_draw(mod* m, stream* s, m4f t) {
+  (void)mod_get_shader(s, t);
 
+  for (int i = 0; i < m->n_meshes; i++) {
     vao_bind(&m->meshes[i].vao);
     gl_draw_elements(GL_TRIANGLES, m->meshes[i].n_inds, GL_UNSIGNED_INT, 0);
   }
 }
 
-shader* mod_get_shader(cam* c, m4f t, float d) {
+shader* mod_get_shader(stream* s, m4f t) {
   static shader* sh = NULL;
   if (!sh) {
-    sh = objdup(shader_new(2,
-                           (shader_spec[]){
-                             {GL_VERTEX_SHADER,   "res/mod.vsh"},
-                             {GL_FRAGMENT_SHADER, "res/mod_light.fsh"},
-                           }));
-  }
-
-  m4f proj = cam_get_proj(c), look = cam_get_look(c, d);
-  shader_mat4(sh, "u_proj", proj);
-  shader_mat4(sh, "u_look", look);
-  shader_vec3(sh, "u_eye", c->pos);
-  shader_mat4(sh, "u_model", t);
+    sh = objdup(mem_tag_gl, shader_new(2,
+                                       (shader_spec[]){
+                                         {GL_VERTEX_SHADER,   "res/mod.vsh"},
+                                         {GL_FRAGMENT_SHADER, "res/mod_light.fsh"},
+                                       }));
+  }
+
+  // the camera comes from the frame block. every draw gets its own block, so
+  // no draw waits on the one before it to be done reading.
+  ssize_t off;
+  draw_consts* c = stream_alloc(s, sizeof(draw_consts), &off);
+  *c = (draw_consts){.model = t};
+  buf_bind_range(&s->buf, draw_ubo_binding, off, sizeof(draw_consts));
   shader_bind(sh);
 
   return sh;
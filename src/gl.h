@@ -4,6 +4,7 @@
 #include <intrin.h>
 #include "typedefs.h"
 #include "err.h"
+#include "map.h"
 #include <assimp/cimport.h>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -28,9 +29,72 @@ float cam_get_yaw(cam* c, float d);
 float cam_get_pitch(cam* c, float d);
 m4f cam_get_look(cam* c, float d);
 m4f cam_get_proj(cam* c);
+frustum cam_get_frustum(cam* c, float d);
+
+/*-- a shadow of the gl state that is bound and toggled every frame, so calls
+     that would change nothing are skipped. render thread only. --*/
+
+// the texture units tex_bind accepts
+#define gl_state_n_units 16
+
+typedef enum gl_state_kind {
+  gl_state_kind_program,
+  gl_state_kind_vao,
+  gl_state_kind_fbo,
+  gl_state_kind_tex,
+  gl_state_kind_cap,
+  gl_state_kind_viewport,
+  gl_state_n_kinds
+} gl_state_kind;
+
+typedef struct gl_state_stats {
+  // calls passed on to gl, and calls skipped because nothing would change
+  size_t n_issued, n_elided;
+} gl_state_stats;
+
+// GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE and GL_SCISSOR_TEST are shadowed.
+// any other cap always goes through.
+void gl_state_enable(uint cap);
+
+void gl_state_disable(uint cap);
+
+void gl_state_viewport(int x, int y, int width, int height);
+
+// the binds below are what shader_bind, vao_bind, fbo_bind and tex_bind go
+// through. id 0 is gl's default object, like the window's framebuffer.
+void gl_state_use_program(uint id);
+
+void gl_state_bind_vao(uint id);
+
+void gl_state_bind_fbo(uint id);
+
+void gl_state_bind_tex(uint unit, uint id);
+
+// the _del functions call these, since gl can hand a deleted name out again
+void gl_state_forget_program(uint id);
+
+void gl_state_forget_vao(uint id);
+
+void gl_state_forget_tex(uint id);
+
+gl_state_stats gl_state_get_stats(gl_state_kind kind);
+
+char const* gl_state_get_kind_name(gl_state_kind kind);
+
+void gl_state_dump(FILE* f);
+
+map_definition(uniform_map, char const*, int, str_hash, str_eq)
+
+// a uniform's location, looked up once by name with shader_get_uniform. -1 if
+// the program has no such active uniform, which gl ignores sets to.
+typedef int uniform;
 
 typedef struct shader {
   uint id;
+
+  // every active uniform's location by name, reflected once at link time.
+  // the keys are owning! copies of the names.
+  uniform_map uniforms;
 } shader;
 
 typedef struct shader_spec {
@@ -40,8 +104,28 @@ typedef struct shader_spec {
 
 shader shader_new(uint n, shader_spec* shaders);
 
+// does nothing if s is already the current program, see gl_state
 void shader_bind(shader* s);
 
+void shader_del(shader* s);
+
+uniform shader_get_uniform(shader* s, char const* n);
+
+// the setters write straight to s's program, so s does not have to be bound.
+// the _at versions take a uniform from shader_get_uniform, and the others
+// look the name up in s's table, never in gl.
+void shader_mat4_at(shader* s, uniform u, m4f m);
+
+void shader_int_at(shader* s, uniform u, int m);
+
+void shader_float_at(shader* s, uniform u, float m);
+
+void shader_vec2_at(shader* s, uniform u, v2f m);
+
+void shader_vec3_at(shader* s, uniform u, v3f m);
+
+void shader_vec4_at(shader* s, uniform u, v4f m);
+
 void shader_mat4(shader* s, char const* n, m4f m);
 
 void shader_int(shader* s, char const* n, int m);
@@ -68,14 +152,108 @@ buf_data_n(buf* b, uint usage, ssize_t elem_size, ssize_t n, void* data);
 
 void buf_data(buf* b, uint usage, ssize_t size_in_bytes, void* data);
 
+// immutable storage; only buf_sub_data can change it afterwards, and only with
+// GL_DYNAMIC_STORAGE_BIT in flags.
+void buf_storage(buf* b, ssize_t size_in_bytes, void* data, uint flags);
+
+void buf_sub_data(buf* b, ssize_t offset, ssize_t size_in_bytes, void* data);
+
 void buf_bind(buf* b);
 
+// for indexed targets like GL_SHADER_STORAGE_BUFFER
+void buf_bind_base(buf* b, uint index);
+
+// binds size bytes from offset. offset has to be a multiple of the target's
+// offset alignment, which stream_alloc's offsets always are.
+void buf_bind_range(buf* b, uint index, ssize_t offset, ssize_t size);
+
+void buf_del(buf* b);
+
+// uniform block binding points shared by every program. the blocks are std140
+// and row_major, so m4f and v4f go in exactly as they are in memory.
+#define frame_ubo_binding 0
+#define draw_ubo_binding 1
+
+// the `frame` block: the camera, written once a frame by frame_ubo_update
+typedef struct frame_consts {
+  m4f proj, look;
+
+  // std140 pads a vec3 to 16 bytes anyway; w is unused
+  v4f eye;
+} frame_consts;
+
+// the `draw` block: whatever changes between draws of one program
+typedef struct draw_consts {
+  m4f model;
+} draw_consts;
+
+// a GL_UNIFORM_BUFFER of size bytes, bound at binding for good
+buf ubo_new(ssize_t size, uint binding);
+
+// writes c at d into b, a ubo_new(sizeof(frame_consts), frame_ubo_binding)
+void frame_ubo_update(buf* b, cam* c, float d);
+
+// frames the gpu may run behind the cpu. a stream is split into one region
+// per frame in flight, and only the oldest one is ever written.
+#define stream_n_frames 3
+
+// a persistently mapped buffer for data that is rewritten every frame. writes
+// go straight into the mapping, with none of buf_data's orphaning, allocation
+// and copy, and a fence per region keeps the cpu from overwriting anything
+// the gpu has yet to read.
+typedef struct stream {
+  buf buf;
+
+  // owned by gl. coherent, so writes need no flush.
+  byte* mapped;
+
+  // every allocation starts on a multiple of align, see stream_alloc
+  ssize_t region_size, align;
+
+  // the region this frame writes to, and how much of it is handed out
+  int region;
+  ssize_t used;
+
+  // set by stream_end once the frame's draws are queued, NULL before
+  GLsync fences[stream_n_frames];
+
+  // frames that had to wait for the gpu to be done with their region
+  size_t n_stalls;
+} stream;
+
+// region_size bytes for each frame in flight. type is the target buf_bind
+// binds s->buf to.
+stream stream_new(uint type, ssize_t region_size);
+
+// moves to the next region, waiting for the gpu to be done with it first.
+// once a frame, before any stream_alloc.
+void stream_begin(stream* s);
+
+// size bytes of this frame's region to write into. *offset gets their offset
+// into s->buf for draw and bind calls; it fits any buffer binding's offset
+// alignment. throws if the region is full, since that means region_size is.
+void* stream_alloc(stream* s, ssize_t size, ssize_t* offset);
+
+// fences this frame's region. after the last draw that reads from it.
+void stream_end(stream* s);
+
+void stream_del(stream* s);
+
+// one line of s's size and stalls, labelled name
+void stream_dump(stream* s, char const* name, FILE* f);
+
+// a GL_UNIFORM_BUFFER stream with room for max_draws draw_consts a frame, each
+// on its own aligned block. mod_draw takes its draw block from it.
+stream draw_stream_new(int max_draws);
+
 typedef struct vao {
   uint id;
 } vao;
 
 void vao_bind(vao* v);
 
+void vao_del(vao* v);
+
 typedef struct attrib {
   int size;
   uint type;
@@ -96,6 +274,15 @@ vao_new(buf* vbo, buf* ibo, uint n, attrib* attrs);
 
 int attrib_get_size_in_bytes(attrib* attr);
 
+// layout of one GL_DRAW_INDIRECT_BUFFER command for *_elements_indirect
+typedef struct draw_elems_cmd {
+  uint count;
+  uint n_instances;
+  uint first_index;
+  int base_vertex;
+  uint base_instance;
+} draw_elems_cmd;
+
 typedef struct tex_spec {
   int width, height, min_filter, mag_filter;
   uint internal_format, format;
@@ -225,8 +412,10 @@ typedef struct mod {
   int n_meshes;
 } mod;
 
-shader* mod_get_shader(cam* c, m4f t, float d);
+// binds a fresh draw block from s holding t, so call it once per model, not
+// per mesh. s is a draw_stream_new, between its stream_begin and stream_end.
+shader* mod_get_shader(stream* s, m4f t);
 mesh mod_load_mesh(mod* m, struct aiMesh* mesh, struct aiScene const* scene);
 void mod_load(mod* m, struct aiNode* node, struct aiScene const* scene);
 mod mod_new(char const* path);
-void mod_draw(mod* m, cam* c, m4f t, float d);
+void mod_draw(mod* m, stream* s, m4f t);
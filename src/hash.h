@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/*-- hash functions for map keys. --*/
+
+// every output bit depends on every input bit, so a table can index with any
+// slice of the hash. bench_hash checks that.
+
+static const uint64_t hash_k1 = 0x87c37b91114253d5ull;
+static const uint64_t hash_k2 = 0x4cf5ad432745937full;
+
+[[gnu::always_inline]]
+inline static uint64_t hash_rotl(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+// murmur3's 64 bit finalizer; a bijection, so distinct inputs never collide
+[[gnu::always_inline]]
+inline static uint64_t hash_mix(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdull;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ull;
+  x ^= x >> 33;
+  return x;
+}
+
+// two 32 bit integers, packed without sign extension and then mixed
+[[gnu::always_inline]]
+inline static uint64_t hash_i32x2(int32_t a, int32_t b) {
+  return hash_mix(((uint64_t)(uint32_t)a << 32) | (uint32_t)b);
+}
+
+// murmur3's 64 bit block mixing, one 8 byte word at a time, for keys of any
+// size and alignment. the length is mixed in so zero padding never collides.
+inline static uint64_t hash_bytes(void const* data, size_t n) {
+  uint8_t const* p = data;
+  uint64_t h = n * hash_k1;
+
+  for (; n >= 8; p += 8, n -= 8) {
+    uint64_t k;
+    memcpy(&k, p, 8);
+
+    k *= hash_k1;
+    k = hash_rotl(k, 31);
+    k *= hash_k2;
+    h ^= k;
+    h = hash_rotl(h, 27) * 5 + 0x52dce729;
+  }
+
+  if (n > 0) {
+    uint64_t k = 0;
+    memcpy(&k, p, n);
+
+    k *= hash_k1;
+    k = hash_rotl(k, 31);
+    k *= hash_k2;
+    h ^= k;
+  }
+
+  return hash_mix(h);
+}
\ No newline at end of file
@@ -1,2 +0,0 @@
-#define FNL_IMPL
-#include "FastNoiseLite.h"
\ No newline at end of file
@@ -1,135 +1,237 @@
 #include "map.h"
+#include "mem.h"
 
-entry* internal_map_new_entries(size_t size) {
-  static const entry invalid_entry = {
-    .key_idx = SIZE_MAX,
-    .val_idx = SIZE_MAX,
-    .next = NULL,
-  };
+// where the index sits in a slot, aligned for map_idx
+static size_t map_idx_off(size_t key_size) {
+  return (key_size + sizeof(map_idx) - 1) & ~(sizeof(map_idx) - 1);
+}
 
-  entry* it = malloc(sizeof(entry) * size);
-  for (int i = 0; i < size; i++) {
-    it[i] = invalid_entry;
-  }
+static map_idx* map_slot_idx(map* d, size_t slot) {
+  return (map_idx*)(d->slots + slot * d->slot_size + map_idx_off(d->key_size));
+}
 
-  return it;
+static void* map_slot_key(map* d, size_t slot) {
+  return d->slots + slot * d->slot_size;
 }
 
-bool internal_map_entry_is_invalid(entry* entry) {
-  return entry->key_idx == SIZE_MAX;
+static size_t map_hash(map* d, void* key) {
+  return d->hash(key);
 }
 
-void internal_map_insert_entry(map* d, entry* e) {
-  size_t insert_index = d->hash(arr_at(d->keys, e->key_idx)) % d->c_entries;
+// the slot holding key, or SIZE_MAX. if free_slot is not NULL it gets the
+// first free slot on the way, where key would be inserted. groups are visited
+// in triangular steps, which reach every group of a power of two table.
+static size_t
+map_find_slot(map* d, void* key, size_t hash, size_t* free_slot) {
+  size_t mask = d->c_slots - 1;
+  byte h2 = map_h2(hash);
+  bool has_free = false;
+
+  for (size_t pos = map_h1(hash) & mask, step = map_group_len;;
+       pos = (pos + step) & mask, step += map_group_len) {
+    byte* group = d->ctrl + pos;
+
+    // the slots are a separate array; start loading them alongside the
+    // control bytes instead of after
+    __builtin_prefetch(map_slot_key(d, pos));
+
+    // a false positive on the 7 bit tag costs one eq call, 1 in 128 slots
+    for (uint32_t m = map_group_match(group, h2); m; m &= m - 1) {
+      size_t slot = (pos + __builtin_ctz(m)) & mask;
+      if (d->eq(key, map_slot_key(d, slot))) {
+        return slot;
+      }
+    }
 
-  if (internal_map_entry_is_invalid(&d->entries[insert_index])) {
-    d->entries[insert_index] = *e;
-  } else {
-    entry* heap = malloc(sizeof(*e));
-    memcpy(heap, e, sizeof(*e));
+    uint32_t m_free = map_group_match_free(group);
+    if (free_slot && !has_free && m_free) {
+      *free_slot = (pos + __builtin_ctz(m_free)) & mask;
+      has_free = true;
+    }
 
-    entry* end = &d->entries[insert_index];
-    while (end->next) {
-      end = end->next;
+    // the key would have been put in this empty slot or before it
+    if (map_group_match(group, map_ctrl_empty)) {
+      return SIZE_MAX;
     }
+  }
+}
 
-    end->next = heap;
+static void map_fill_slot(map* d, size_t slot, size_t hash, map_idx idx) {
+  if (d->ctrl[slot] == map_ctrl_tomb) {
+    d->n_tombs--;
   }
 
-  d->n_entries++;
+  map_set_ctrl_at(d->ctrl, d->c_slots, slot, map_h2(hash));
+  memcpy(map_slot_key(d, slot), arr_at(d->keys, idx), d->key_size);
+  *map_slot_idx(d, slot) = idx;
 }
 
-void map_add(map* d, void* key, void* val) {
-  if (d->n_entries > d->c_entries * (long double)d->load_factor) {
-    map new_d = {
-      .keys = d->keys,
-      .vals = d->vals,
-      .entries = internal_map_new_entries(d->c_entries * 2),
-      .c_entries = d->c_entries * 2,
-      .n_entries = 0,
-      .eq = d->eq,
-      .hash = d->hash,
-      .load_factor = d->load_factor,
-      .key_size = d->key_size,
-      .val_size = d->val_size
-    };
-
-    for (int i = 0; i < d->c_entries; i++) {
-      entry* e = &d->entries[i];
-      if (internal_map_entry_is_invalid(e)) {
-        continue;
-      }
+// points a free slot on hash's probe sequence at keys[idx]
+static void map_insert_slot(map* d, size_t hash, map_idx idx) {
+  size_t mask = d->c_slots - 1;
 
-      if (e->next) {
-        entry* e1 = e->next;
-        while (e1) {
-          entry to_insert = *e1;
-          to_insert.next = NULL;
-          internal_map_insert_entry(&new_d, &to_insert);
-          entry* to_free = e1;
-          e1 = e1->next;
-          free(to_free);
-        }
-      }
-
-      e->next = NULL;
-      internal_map_insert_entry(&new_d, e);
+  for (size_t pos = map_h1(hash) & mask, step = map_group_len;;
+       pos = (pos + step) & mask, step += map_group_len) {
+    uint32_t m = map_group_match_free(d->ctrl + pos);
+    if (m) {
+      map_fill_slot(d, (pos + __builtin_ctz(m)) & mask, hash, idx);
+      return;
     }
+  }
+}
+
+// rebuilds the table at c_slots from keys, which also drops every tomb
+static void map_rehash(map* d, size_t c_slots) {
+  mem_free(d->ctrl);
+  mem_free(d->slots);
 
-    map_add(&new_d, key, val);
-    free(d->entries);
-    *d = new_d;
+  d->c_slots = c_slots;
+  d->n_tombs = 0;
+  d->ctrl = mem_alloc(mem_tag_map, c_slots + map_group_len);
+  d->slots = mem_alloc(mem_tag_map, c_slots * d->slot_size);
+  memset(d->ctrl, map_ctrl_empty, c_slots + map_group_len);
 
-    return;
+  for (size_t i = 0; i < arr_len(d->keys); i++) {
+    map_insert_slot(d, map_hash(d, arr_at(d->keys, i)), (map_idx)i);
   }
+}
+
+void* map_get_or_insert(map* d, void* key, bool* is_new) {
+  size_t hash = map_hash(d, key);
 
+  size_t free_slot;
+  size_t slot = map_find_slot(d, key, hash, &free_slot);
+  if (slot != SIZE_MAX) {
+    *is_new = false;
+    return arr_at(d->vals, *map_slot_idx(d, slot));
+  }
+
+  *is_new = true;
+
+  // the val starts zeroed, for the caller to fill in
+  byte zero[d->val_size];
+  memset(zero, 0, d->val_size);
   arr_add(&d->keys, key);
-  arr_add(&d->vals, val);
+  arr_add(&d->vals, zero);
+  map_idx idx = (map_idx)(arr_len(d->keys) - 1);
+
+  // a rehash makes the free slot found above stale, so this is the one case
+  // that probes twice. the new key is already in keys, so the rehash places it
+  size_t c_slots = map_get_rehash_slots(d->c_slots, d->n_entries, d->n_tombs,
+                                        d->load_factor);
+  if (c_slots) {
+    map_rehash(d, c_slots);
+  } else {
+    map_fill_slot(d, free_slot, hash, idx);
+  }
 
-  entry e = {
-    .key_idx = arr_len(d->keys) - 1,
-    .val_idx = arr_len(d->vals) - 1,
-    .next = NULL
-  };
+  d->n_entries++;
+  return arr_at(d->vals, idx);
+}
 
-  internal_map_insert_entry(d, &e);
+void map_add(map* d, void* key, void* val) {
+  bool is_new;
+  memcpy(map_get_or_insert(d, key, &is_new), val, d->val_size);
 }
 
 void* map_at(map* d, void* key) {
-  size_t bucket_index = d->hash(key) % d->c_entries;
-  if (internal_map_entry_is_invalid(&d->entries[bucket_index])) {
+  size_t slot = map_find_slot(d, key, map_hash(d, key), NULL);
+  if (slot == SIZE_MAX) {
     return NULL;
   }
 
-  entry* end = &d->entries[bucket_index];
-  while (end && !d->eq(key, arr_at(d->keys, end->key_idx))) {
-    end = end->next;
+  return arr_at(d->vals, *map_slot_idx(d, slot));
+}
+
+bool map_has(map* d, void* key) {
+  return map_at(d, key) != NULL;
+}
+
+void map_reserve(map* d, size_t n_entries) {
+  arr_reserve(&d->keys, n_entries);
+  arr_reserve(&d->vals, n_entries);
+
+  size_t c_slots = map_get_c_slots(n_entries, d->load_factor);
+  if (c_slots > d->c_slots) {
+    map_rehash(d, c_slots);
   }
+}
 
-  if (!end) {
-    return NULL;
+map_iter map_iter_new(map* d) {
+  return (map_iter){.d = d, .i = SIZE_MAX};
+}
+
+bool map_iter_next(map_iter* it) {
+  it->i++;
+  if (it->i >= arr_len(it->d->keys)) {
+    return false;
   }
 
-  return arr_at(d->vals, end->val_idx);
+  it->key = arr_at(it->d->keys, it->i);
+  it->val = arr_at(it->d->vals, it->i);
+  return true;
 }
 
-bool map_has(map* d, void* key) {
-  return map_at(d, key) != NULL;
+bool map_remove(map* d, void* key) {
+  size_t slot = map_find_slot(d, key, map_hash(d, key), NULL);
+  if (slot == SIZE_MAX) {
+    return false;
+  }
+
+  // the slot may sit in the middle of another key's probe sequence, so it
+  // becomes a tomb rather than empty
+  map_idx idx = *map_slot_idx(d, slot);
+  map_set_ctrl_at(d->ctrl, d->c_slots, slot, map_ctrl_tomb);
+  d->n_tombs++;
+  d->n_entries--;
+
+  // keep keys and vals dense by moving the last pair into the hole
+  size_t last = arr_len(d->keys) - 1;
+  if (idx != last) {
+    void* last_key = arr_at(d->keys, last);
+    size_t moved = map_find_slot(d, last_key, map_hash(d, last_key), NULL);
+    *map_slot_idx(d, moved) = idx;
+
+    memcpy(arr_at(d->keys, idx), last_key, d->key_size);
+    memcpy(arr_at(d->vals, idx), arr_at(d->vals, last), d->val_size);
+  }
+
+  arr_len(d->keys)--;
+  arr_len(d->vals)--;
+
+  return true;
+}
+
+void map_del(map* d) {
+  arr_del(d->keys);
+  arr_del(d->vals);
+  mem_free(d->ctrl);
+  mem_free(d->slots);
+  *d = (map){};
 }
 
 map
 map_new(size_t initial_size, size_t key_size, size_t val_size, float load_factor,
     bool (* eq)(void*, void*), size_t (* hash)(void*)) {
-  return (map){
-    .keys = internal_arr_new(initial_size, key_size),
-    .vals = internal_arr_new(initial_size, val_size),
-    .entries = internal_map_new_entries(initial_size),
-    .c_entries = initial_size,
+  load_factor = map_get_load_factor(load_factor);
+
+  // arrs can not grow from 0
+  initial_size = max(initial_size, (size_t)1);
+
+  map d = {
+    .keys = internal_arr_new(initial_size, key_size, mem_here),
+    .vals = internal_arr_new(initial_size, val_size, mem_here),
     .n_entries = 0,
     .load_factor = load_factor,
     .eq = eq,
     .hash = hash,
     .key_size = key_size,
-    .val_size = val_size
+    .val_size = val_size,
+
+    // the key, then its index, padded so 8 byte keys stay aligned
+    .slot_size = (map_idx_off(key_size) + sizeof(map_idx) + 7) & ~(size_t)7
   };
-}
+
+  map_rehash(&d, map_get_c_slots(initial_size, load_factor));
+  return d;
+}
\ No newline at end of file
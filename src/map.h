@@ -4,18 +4,124 @@
 #include "typedefs.h"
 #include "arr.h"
 #include "err.h"
+#include "hash.h"
+#include "mem.h"
 
-typedef struct entry {
-  size_t key_idx;
-  size_t val_idx;
-  struct entry* next;
-} entry;
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*-- open addressing hash map with swisstable-style control bytes. --*/
+
+// hash functions must mix well, like the ones in hash.h: the low 7 bits go in
+// the control byte and the rest pick the slot, with no mixing in between.
+
+// the table is probed a group of control bytes at a time, one sse2 compare
+// per group
+#define map_group_len 16
+
+// control byte of a slot: 0xxxxxxx is full, holding the low 7 bits of the
+// key's hash; the others mark a slot that is free.
+#define map_ctrl_empty ((byte)0x80)
+#define map_ctrl_tomb ((byte)0xfe)
+
+// index into keys and vals, stored in every full slot
+typedef uint32_t map_idx;
+
+[[gnu::always_inline]]
+inline static byte map_h2(size_t hash) {
+  return (byte)(hash & 0x7f);
+}
+
+[[gnu::always_inline]]
+inline static size_t map_h1(size_t hash) {
+  return hash >> 7;
+}
+
+// bit i is set if group[i] == b
+[[gnu::always_inline]]
+inline static uint32_t map_group_match(byte const* group, byte b) {
+#if defined(__SSE2__)
+  __m128i g = _mm_loadu_si128((__m128i const*)group);
+  return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)b)));
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < map_group_len; i++) {
+    mask |= (uint32_t)(group[i] == b) << i;
+  }
+
+  return mask;
+#endif
+}
+
+// bit i is set if group[i] is empty or a tomb; only those have the top bit
+[[gnu::always_inline]]
+inline static uint32_t map_group_match_free(byte const* group) {
+#if defined(__SSE2__)
+  return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((__m128i const*)group));
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < map_group_len; i++) {
+    mask |= (uint32_t)(group[i] >> 7) << i;
+  }
+
+  return mask;
+#endif
+}
+
+[[gnu::always_inline]]
+inline static void
+map_set_ctrl_at(byte* ctrl, size_t c_slots, size_t slot, byte b) {
+  ctrl[slot] = b;
+  if (slot < map_group_len) {
+    ctrl[c_slots + slot] = b;
+  }
+}
+
+// there must always be an empty slot for probes to stop at
+inline static float map_get_load_factor(float load_factor) {
+  return load_factor <= 0 || load_factor > 0.875f ? 0.875f : load_factor;
+}
+
+// a power of two that fits n_entries
+inline static size_t map_get_c_slots(size_t n_entries, float load_factor) {
+  size_t c_slots = map_group_len;
+  while ((float)n_entries > (float)c_slots * load_factor) {
+    c_slots *= 2;
+  }
+
+  return c_slots;
+}
+
+// the size to rehash to before inserting one more key, or 0 if it fits.
+// tombs take up probe length like full slots do. grow if the entries alone
+// fill most of the table, otherwise a same-size rehash clears the tombs and
+// leaves a quarter of the budget for new keys.
+inline static size_t map_get_rehash_slots(size_t c_slots, size_t n_entries,
+                                          size_t n_tombs, float load_factor) {
+  float c_max = (float)c_slots * load_factor;
+  if ((float)(n_entries + n_tombs + 1) <= c_max) {
+    return 0;
+  }
+
+  return (float)(n_entries + 1) > c_max * 0.75f ? c_slots * 2 : c_slots;
+}
 
 typedef struct map {
+  // keys and vals are dense arrs, in insertion order until a removal
   void* keys;
   void* vals;
-  entry* entries;
-  size_t c_entries, n_entries, key_size, val_size;
+
+  // c_slots control bytes, followed by a copy of the first map_group_len so
+  // a group can be loaded at any slot without wrapping
+  byte* ctrl;
+
+  // c_slots slots of slot_size bytes: the key itself, so a probe compares
+  // keys without leaving the table, then its index into keys and vals
+  byte* slots;
+
+  // c_slots is a power of two, n_tombs counts removed slots not yet reused
+  size_t c_slots, n_entries, n_tombs, key_size, val_size, slot_size;
   float load_factor;
 
   bool (* eq)(void* lhs, void* rhs);
@@ -23,18 +129,233 @@ typedef struct map {
   size_t (* hash)(void* key);
 } map;
 
-entry* internal_map_new_entries(size_t size);
-
 map
 map_new(size_t initial_size, size_t key_size, size_t val_size, float load_factor,
     bool(* eq)(void*, void*), size_t(* hash)(void*));
 
-bool internal_map_entry_is_invalid(entry* entry);
-
-void internal_map_insert_entry(map* d, entry* e);
-
+// replaces the value if key is already present
 void map_add(map* d, void* key, void* val);
 
+// the value at key, inserting a zeroed one if key is not present, with a
+// single probe unless the insert grows the table. is_new tells which.
+void* map_get_or_insert(map* d, void* key, bool* is_new);
+
 void* map_at(map* d, void* key);
 
-bool map_has(map* d, void* key);
\ No newline at end of file
+bool map_has(map* d, void* key);
+
+// swaps the last key/val into the removed slot, so pointers from map_at are
+// invalidated. returns false if the key was not present.
+bool map_remove(map* d, void* key);
+
+// grows the table and the dense arrs so n_entries fit without another rehash
+// or realloc
+void map_reserve(map* d, size_t n_entries);
+
+// walks the dense keys and vals in order:
+//   for (map_iter it = map_iter_new(&m); map_iter_next(&it);) { ... }
+// adding or removing entries invalidates the iterator.
+typedef struct map_iter {
+  map* d;
+  size_t i;
+  void* key;
+  void* val;
+} map_iter;
+
+map_iter map_iter_new(map* d);
+
+bool map_iter_next(map_iter* it);
+
+void map_del(map* d);
+
+// a map specialized for K and V, so hash and eq inline and keys and vals are
+// copied with plain stores. same table as map, but keys and vals are plain
+// arrays of n_entries, so iterating is a for loop over them:
+//   map_definition(chunk_map, v2i, chunk*, iv2_hash, iv2_eq)
+// hash and eq take K*, like the ones map takes.
+#define map_definition(name, K, V, hash_fn, eq_fn)                             \
+typedef struct name##_slot {                                                   \
+  K key;                                                                       \
+  map_idx idx;                                                                 \
+} name##_slot;                                                                 \
+                                                                               \
+typedef struct name {                                                          \
+  K* keys;                                                                     \
+  V* vals;                                                                     \
+  byte* ctrl;                                                                  \
+  name##_slot* slots;                                                          \
+  size_t c_slots, c_entries, n_entries, n_tombs;                               \
+  float load_factor;                                                           \
+} name;                                                                        \
+                                                                               \
+inline static size_t name##_hash(K* key) {                                     \
+  return hash_fn(key);                                                         \
+}                                                                              \
+                                                                               \
+inline static size_t                                                           \
+name##_find_slot(name* d, K* key, size_t hash, size_t* free_slot) {            \
+  size_t mask = d->c_slots - 1;                                                \
+  byte h2 = map_h2(hash);                                                      \
+  bool has_free = false;                                                       \
+                                                                               \
+  for (size_t pos = map_h1(hash) & mask, step = map_group_len;;                \
+       pos = (pos + step) & mask, step += map_group_len) {                     \
+    byte* group = d->ctrl + pos;                                               \
+    __builtin_prefetch(&d->slots[pos]);                                        \
+                                                                               \
+    for (uint32_t m = map_group_match(group, h2); m; m &= m - 1) {             \
+      size_t slot = (pos + __builtin_ctz(m)) & mask;                           \
+      if (eq_fn(key, &d->slots[slot].key)) {                                   \
+        return slot;                                                           \
+      }                                                                        \
+    }                                                                          \
+                                                                               \
+    uint32_t m_free = map_group_match_free(group);                             \
+    if (free_slot && !has_free && m_free) {                                    \
+      *free_slot = (pos + __builtin_ctz(m_free)) & mask;                       \
+      has_free = true;                                                         \
+    }                                                                          \
+                                                                               \
+    if (map_group_match(group, map_ctrl_empty)) {                              \
+      return SIZE_MAX;                                                         \
+    }                                                                          \
+  }                                                                            \
+}                                                                              \
+                                                                               \
+inline static void                                                             \
+name##_fill_slot(name* d, size_t slot, size_t hash, map_idx idx) {             \
+  if (d->ctrl[slot] == map_ctrl_tomb) {                                        \
+    d->n_tombs--;                                                              \
+  }                                                                            \
+                                                                               \
+  map_set_ctrl_at(d->ctrl, d->c_slots, slot, map_h2(hash));                    \
+  d->slots[slot] = (name##_slot){.key = d->keys[idx], .idx = idx};             \
+}                                                                              \
+                                                                               \
+inline static void name##_insert_slot(name* d, size_t hash, map_idx idx) {     \
+  size_t mask = d->c_slots - 1;                                                \
+                                                                               \
+  for (size_t pos = map_h1(hash) & mask, step = map_group_len;;                \
+       pos = (pos + step) & mask, step += map_group_len) {                     \
+    uint32_t m = map_group_match_free(d->ctrl + pos);                          \
+    if (m) {                                                                   \
+      name##_fill_slot(d, (pos + __builtin_ctz(m)) & mask, hash, idx);         \
+      return;                                                                  \
+    }                                                                          \
+  }                                                                            \
+}                                                                              \
+                                                                               \
+inline static void name##_rehash(name* d, size_t c_slots) {                    \
+  mem_free(d->ctrl);                                                           \
+  mem_free(d->slots);                                                          \
+                                                                               \
+  d->c_slots = c_slots;                                                        \
+  d->n_tombs = 0;                                                              \
+  d->ctrl = mem_alloc(mem_tag_map, c_slots + map_group_len);                   \
+  d->slots = mem_alloc(mem_tag_map, sizeof(name##_slot) * c_slots);            \
+  memset(d->ctrl, map_ctrl_empty, c_slots + map_group_len);                    \
+                                                                               \
+  for (size_t i = 0; i < d->n_entries; i++) {                                  \
+    name##_insert_slot(d, name##_hash(&d->keys[i]), (map_idx)i);               \
+  }                                                                            \
+}                                                                              \
+                                                                               \
+inline static void name##_reserve_entries(name* d, size_t c_entries) {         \
+  if (c_entries <= d->c_entries) {                                             \
+    return;                                                                    \
+  }                                                                            \
+                                                                               \
+  d->c_entries = c_entries;                                                    \
+  d->keys = mem_realloc(mem_tag_map, d->keys, sizeof(K) * c_entries);          \
+  d->vals = mem_realloc(mem_tag_map, d->vals, sizeof(V) * c_entries);          \
+}                                                                              \
+                                                                               \
+inline static name name##_new(size_t initial_size, float load_factor) {        \
+  name d = {.load_factor = map_get_load_factor(load_factor)};                  \
+  name##_reserve_entries(&d, max(initial_size, (size_t)1));                    \
+  name##_rehash(&d, map_get_c_slots(initial_size, d.load_factor));             \
+  return d;                                                                    \
+}                                                                              \
+                                                                               \
+inline static V* name##_get_or_insert(name* d, K key, bool* is_new) {          \
+  size_t hash = name##_hash(&key);                                             \
+                                                                               \
+  size_t free_slot = SIZE_MAX;                                                 \
+  size_t slot = name##_find_slot(d, &key, hash, &free_slot);                   \
+  if (slot != SIZE_MAX) {                                                      \
+    *is_new = false;                                                           \
+    return &d->vals[d->slots[slot].idx];                                       \
+  }                                                                            \
+                                                                               \
+  *is_new = true;                                                              \
+  if (d->n_entries == d->c_entries) {                                          \
+    name##_reserve_entries(d, d->c_entries * 2);                               \
+  }                                                                            \
+                                                                               \
+  map_idx idx = (map_idx)d->n_entries++;                                       \
+  d->keys[idx] = key;                                                          \
+  memset(&d->vals[idx], 0, sizeof(V));                                         \
+                                                                               \
+  size_t c_slots = map_get_rehash_slots(d->c_slots, d->n_entries - 1,          \
+                                        d->n_tombs, d->load_factor);           \
+  if (c_slots) {                                                               \
+    name##_rehash(d, c_slots);                                                 \
+  } else {                                                                     \
+    name##_fill_slot(d, free_slot, hash, idx);                                 \
+  }                                                                            \
+                                                                               \
+  return &d->vals[idx];                                                        \
+}                                                                              \
+                                                                               \
+inline static void name##_add(name* d, K key, V val) {                         \
+  bool is_new;                                                                 \
+  *name##_get_or_insert(d, key, &is_new) = val;                                \
+}                                                                              \
+                                                                               \
+inline static V* name##_at(name* d, K key) {                                   \
+  size_t slot = name##_find_slot(d, &key, name##_hash(&key), NULL);            \
+  return slot == SIZE_MAX ? NULL : &d->vals[d->slots[slot].idx];               \
+}                                                                              \
+                                                                               \
+inline static bool name##_has(name* d, K key) {                                \
+  return name##_at(d, key) != NULL;                                            \
+}                                                                              \
+                                                                               \
+inline static bool name##_remove(name* d, K key) {                             \
+  size_t slot = name##_find_slot(d, &key, name##_hash(&key), NULL);            \
+  if (slot == SIZE_MAX) {                                                      \
+    return false;                                                              \
+  }                                                                            \
+                                                                               \
+  map_idx idx = d->slots[slot].idx;                                            \
+  map_set_ctrl_at(d->ctrl, d->c_slots, slot, map_ctrl_tomb);                   \
+  d->n_tombs++;                                                                \
+                                                                               \
+  size_t last = --d->n_entries;                                                \
+  if (idx != last) {                                                           \
+    K* last_key = &d->keys[last];                                              \
+    size_t moved = name##_find_slot(d, last_key, name##_hash(last_key), NULL); \
+    d->slots[moved].idx = idx;                                                 \
+    d->keys[idx] = d->keys[last];                                              \
+    d->vals[idx] = d->vals[last];                                              \
+  }                                                                            \
+                                                                               \
+  return true;                                                                 \
+}                                                                              \
+                                                                               \
+inline static void name##_reserve(name* d, size_t n_entries) {                 \
+  name##_reserve_entries(d, n_entries);                                        \
+                                                                               \
+  size_t c_slots = map_get_c_slots(n_entries, d->load_factor);                 \
+  if (c_slots > d->c_slots) {                                                  \
+    name##_rehash(d, c_slots);                                                 \
+  }                                                                            \
+}                                                                              \
+                                                                               \
+inline static void name##_del(name* d) {                                       \
+  mem_free(d->keys);                                                           \
+  mem_free(d->vals);                                                           \
+  mem_free(d->ctrl);                                                           \
+  mem_free(d->slots);                                                          \
+  *d = (name){};                                                               \
+}
@@ -0,0 +1,208 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "mem.h"
+#include "err.h"
+
+// 16 bytes on 64 bit, which keeps what follows aligned like malloc's own
+typedef struct mem_header {
+  size_t size;
+  mem_tag tag;
+} mem_header;
+
+typedef struct mem_counters {
+  atomic_size_t live_bytes, peak_bytes, n_live, n_allocs, n_alloc_bytes;
+} mem_counters;
+
+static mem_counters counters[mem_n_tags];
+
+static char const* tag_names[mem_n_tags] = {
+  [mem_tag_world] = "world",
+  [mem_tag_map] = "map",
+  [mem_tag_arr] = "arr",
+  [mem_tag_arena] = "arena",
+  [mem_tag_model] = "model",
+  [mem_tag_gl] = "gl",
+  [mem_tag_pool] = "pool",
+};
+
+static double now_s() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// when the first allocation happened, for rates
+static _Atomic double start_s;
+
+static atomic_size_t n_frame_allocs;
+
+// only touched by the thread that called mem_frame_begin
+static _Thread_local bool is_frame_thread;
+static mem_site frame_sites[mem_max_frame_sites];
+static size_t n_frame_sites, n_frame_thread_allocs;
+
+static void mem_count_alloc(mem_tag tag, size_t size, mem_site site) {
+  atomic_fetch_add_explicit(&n_frame_allocs, 1, memory_order_relaxed);
+  if (is_frame_thread) {
+    if (n_frame_sites < mem_max_frame_sites) {
+      frame_sites[n_frame_sites++] = site;
+    }
+
+    n_frame_thread_allocs++;
+  }
+
+  mem_counters* c = &counters[tag];
+  size_t live = atomic_fetch_add_explicit(&c->live_bytes, size,
+                                          memory_order_relaxed) + size;
+  atomic_fetch_add_explicit(&c->n_live, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&c->n_allocs, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&c->n_alloc_bytes, size, memory_order_relaxed);
+
+  size_t peak = atomic_load_explicit(&c->peak_bytes, memory_order_relaxed);
+  while (live > peak &&
+         !atomic_compare_exchange_weak_explicit(&c->peak_bytes, &peak, live,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {}
+
+  double zero = 0;
+  if (atomic_load_explicit(&start_s, memory_order_relaxed) == 0) {
+    atomic_compare_exchange_strong(&start_s, &zero, now_s());
+  }
+}
+
+static void mem_count_free(mem_header* h) {
+  mem_counters* c = &counters[h->tag];
+  atomic_fetch_sub_explicit(&c->live_bytes, h->size, memory_order_relaxed);
+  atomic_fetch_sub_explicit(&c->n_live, 1, memory_order_relaxed);
+}
+
+void* mem_alloc_at(mem_tag tag, size_t size, mem_site site) {
+  mem_header* h = malloc(sizeof(mem_header) + size);
+  if (!h) {
+    throw_c("Out of memory!");
+  }
+
+  *h = (mem_header){.size = size, .tag = tag};
+  mem_count_alloc(tag, size, site);
+  return h + 1;
+}
+
+void* mem_calloc_at(mem_tag tag, size_t n, size_t size, mem_site site) {
+  void* ptr = mem_alloc_at(tag, n * size, site);
+  memset(ptr, 0, n * size);
+  return ptr;
+}
+
+void* mem_realloc_at(mem_tag tag, void* ptr, size_t size, mem_site site) {
+  if (!ptr) {
+    return mem_alloc_at(tag, size, site);
+  }
+
+  mem_header* h = (mem_header*)ptr - 1;
+  mem_count_free(h);
+
+  h = realloc(h, sizeof(mem_header) + size);
+  if (!h) {
+    throw_c("Out of memory!");
+  }
+
+  *h = (mem_header){.size = size, .tag = tag};
+  mem_count_alloc(tag, size, site);
+  return h + 1;
+}
+
+void mem_free(void* ptr) {
+  if (!ptr) {
+    return;
+  }
+
+  mem_header* h = (mem_header*)ptr - 1;
+  mem_count_free(h);
+  free(h);
+}
+
+mem_stats mem_get_stats(mem_tag tag) {
+  mem_counters* c = &counters[tag];
+  return (mem_stats){
+    .live_bytes = atomic_load(&c->live_bytes),
+    .peak_bytes = atomic_load(&c->peak_bytes),
+    .n_live = atomic_load(&c->n_live),
+    .n_allocs = atomic_load(&c->n_allocs),
+    .n_alloc_bytes = atomic_load(&c->n_alloc_bytes),
+  };
+}
+
+char const* mem_get_tag_name(mem_tag tag) {
+  return tag_names[tag];
+}
+
+void mem_dump(FILE* f) {
+  double start = atomic_load(&start_s);
+  double per_s = start ? 1 / (now_s() - start) : 0;
+
+  fprintf(f, "%-6s %12s %12s %10s %12s %12s\n", "tag", "live KiB", "peak KiB",
+          "live", "allocs/s", "KiB/s");
+
+  mem_stats total = {0};
+  for (int i = 0; i < mem_n_tags; i++) {
+    mem_stats s = mem_get_stats(i);
+    fprintf(f, "%-6s %12.1f %12.1f %10zu %12.1f %12.1f\n", tag_names[i],
+            s.live_bytes / 1024., s.peak_bytes / 1024., s.n_live,
+            s.n_allocs * per_s, s.n_alloc_bytes / 1024. * per_s);
+
+    total.live_bytes += s.live_bytes;
+    total.n_live += s.n_live;
+  }
+
+  fprintf(f, "%-6s %12.1f %12s %10zu\n", "total", total.live_bytes / 1024.,
+          "", total.n_live);
+}
+
+static void mem_dump_stderr() {
+  mem_dump(stderr);
+}
+
+void mem_dump_at_exit() {
+  atexit(mem_dump_stderr);
+}
+
+void mem_frame_begin() {
+  is_frame_thread = true;
+  n_frame_sites = 0;
+  n_frame_thread_allocs = 0;
+  atomic_store(&n_frame_allocs, 0);
+}
+
+size_t mem_get_frame_allocs() {
+  return atomic_load(&n_frame_allocs);
+}
+
+void mem_dump_frame_sites(FILE* f) {
+  for (size_t i = 0; i < n_frame_sites; i++) {
+    // each site once, on its first appearance
+    bool is_first = true;
+    int n = 0;
+    for (size_t j = 0; j < n_frame_sites; j++) {
+      bool is_same = frame_sites[j].line == frame_sites[i].line &&
+                     !strcmp(frame_sites[j].file, frame_sites[i].file);
+      is_first &= !is_same || j >= i;
+      n += is_same;
+    }
+
+    if (is_first) {
+      fprintf(f, "  %s:%d, %d allocations\n", frame_sites[i].file,
+              frame_sites[i].line, n);
+    }
+  }
+
+  if (n_frame_thread_allocs > n_frame_sites) {
+    fprintf(f, "  %zu more\n", n_frame_thread_allocs - n_frame_sites);
+  }
+
+  size_t n_other = mem_get_frame_allocs() - n_frame_thread_allocs;
+  if (n_other > 0) {
+    fprintf(f, "  %zu on other threads\n", n_other);
+  }
+}
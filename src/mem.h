@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+#include "typedefs.h"
+
+/*-- malloc with live and peak byte counts per subsystem. --*/
+
+typedef enum mem_tag {
+  mem_tag_world,
+  mem_tag_map,
+  mem_tag_arr,
+  mem_tag_arena,
+  mem_tag_model,
+  mem_tag_gl,
+  mem_tag_pool,
+  mem_n_tags
+} mem_tag;
+
+typedef struct mem_stats {
+  size_t live_bytes, peak_bytes, n_live;
+
+  // since the first allocation. two snapshots give a rate over any window.
+  size_t n_allocs, n_alloc_bytes;
+} mem_stats;
+
+// where an allocation was asked for, for the per-frame report
+typedef struct mem_site {
+  char const* file;
+  int line;
+} mem_site;
+
+#define mem_here ((mem_site){__FILE__, __LINE__})
+
+// every allocation carries a small header with its size and tag, so
+// mem_free needs neither. the pointers are as aligned as malloc's.
+// the _at versions take the site from a caller further up, like arr's
+// functions do, so the report names the code that grew the arr rather
+// than arr.c.
+void* mem_alloc_at(mem_tag tag, size_t size, mem_site site);
+
+void* mem_calloc_at(mem_tag tag, size_t n, size_t size, mem_site site);
+
+// ptr may be NULL. the allocation moves to tag, whatever it had before.
+void* mem_realloc_at(mem_tag tag, void* ptr, size_t size, mem_site site);
+
+#define mem_alloc(tag, size) mem_alloc_at(tag, size, mem_here)
+#define mem_calloc(tag, n, size) mem_calloc_at(tag, n, size, mem_here)
+#define mem_realloc(tag, ptr, size) mem_realloc_at(tag, ptr, size, mem_here)
+
+// a tracked heap copy of a value, e.g. objdup(mem_tag_gl, shader_new(...))
+#define objdup(tag, ...) \
+  ({ __typeof__ (__VA_ARGS__) _a = (__VA_ARGS__); \
+     memcpy(mem_alloc(tag, sizeof(_a)), &_a, sizeof(_a));\
+  })
+
+// ptr may be NULL, otherwise it must come from mem_alloc and friends
+void mem_free(void* ptr);
+
+// safe to call from any thread while others allocate; each field is exact,
+// but fields may be from slightly different moments
+mem_stats mem_get_stats(mem_tag tag);
+
+char const* mem_get_tag_name(mem_tag tag);
+
+// a table of every tag's stats, with rates over the process' lifetime
+void mem_dump(FILE* f);
+
+// dumps to stderr at exit, including exits through throw_c
+void mem_dump_at_exit();
+
+// sites kept per frame; further allocations are only counted
+#define mem_max_frame_sites 32
+
+// starts counting a frame's allocations, on every thread. sites are only
+// kept for the thread that calls this.
+void mem_frame_begin();
+
+// allocations since mem_frame_begin
+size_t mem_get_frame_allocs();
+
+// every distinct site of this frame's allocations, with its count
+void mem_dump_frame_sites(FILE* f);
\ No newline at end of file
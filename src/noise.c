@@ -0,0 +1,203 @@
+// the fnl implementation lives in this translation unit, so the batched kernels
+// can share its gradient table and hashing constants.
+#define FNL_IMPL
+#include "noise.h"
+#include "cpu.h"
+#include <stdint.h>
+
+// every helper taking or returning a vector is always inlined, so no vector
+// actually crosses a call boundary in the sse2 build
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+typedef float f32xn __attribute__((vector_size(noise_lanes * sizeof(float))));
+typedef int32_t i32xn __attribute__((vector_size(noise_lanes * sizeof(int))));
+typedef uint32_t u32xn __attribute__((vector_size(noise_lanes * sizeof(int))));
+
+[[gnu::always_inline]]
+inline static f32xn noise_select(i32xn mask, f32xn yes, f32xn no) {
+  return (f32xn)(((i32xn)yes & mask) | ((i32xn)no & ~mask));
+}
+
+[[gnu::always_inline]]
+inline static f32xn noise_splat(float f) {
+  return (f32xn){} + f;
+}
+
+// _fnlGradCoord2D, one lane at a time for the table lookup
+[[gnu::always_inline]]
+inline static f32xn
+noise_grad(u32xn seed, u32xn xp, u32xn yp, f32xn xd, f32xn yd) {
+  u32xn hash = (seed ^ xp ^ yp) * 0x27d4eb2du;
+  hash ^= hash >> 15;
+  hash &= 127 << 1;
+
+  f32xn gx, gy;
+  for (int k = 0; k < noise_lanes; k++) {
+    gx[k] = GRADIENTS_2D[hash[k]];
+    gy[k] = GRADIENTS_2D[hash[k] | 1];
+  }
+
+  return xd * gx + yd * gy;
+}
+
+// _fnlSingleSimplex2D on already skewed coordinates
+[[gnu::always_inline]]
+inline static f32xn noise_simplex(int seed, f32xn x, f32xn y) {
+  const float SQRT3 = 1.7320508075688772935274463415059f;
+  const float G2 = (3 - SQRT3) / 6;
+  const float C_T = (float)(2 * (1 - 2 * G2) * (1 / G2 - 2));
+  const float C_A = (float)(-2 * (1 - 2 * G2) * (1 - 2 * G2));
+  const f32xn zero = {};
+
+  // _fnlFastFloor: truncate, then step down for negatives (even integral ones)
+  i32xn i = __builtin_convertvector(x, i32xn) + (i32xn)(x < zero);
+  i32xn j = __builtin_convertvector(y, i32xn) + (i32xn)(y < zero);
+  f32xn xi = x - __builtin_convertvector(i, f32xn);
+  f32xn yi = y - __builtin_convertvector(j, f32xn);
+
+  f32xn t = (xi + yi) * G2;
+  f32xn x0 = xi - t;
+  f32xn y0 = yi - t;
+
+  u32xn ip = (u32xn)i * (uint32_t)PRIME_X;
+  u32xn jp = (u32xn)j * (uint32_t)PRIME_Y;
+  u32xn s = (u32xn){} + (uint32_t)seed;
+
+  f32xn a = 0.5f - x0 * x0 - y0 * y0;
+  f32xn n0 = noise_select(
+    a > zero, (a * a) * (a * a) * noise_grad(s, ip, jp, x0, y0), zero);
+
+  f32xn c = C_T * t + (C_A + a);
+  f32xn x2 = x0 + (2 * (float)G2 - 1);
+  f32xn y2 = y0 + (2 * (float)G2 - 1);
+  f32xn n2 = noise_select(
+    c > zero,
+    (c * c) * (c * c) *
+    noise_grad(s, ip + (uint32_t)PRIME_X, jp + (uint32_t)PRIME_Y, x2, y2),
+    zero);
+
+  // the middle corner depends on which triangle of the cell we are in
+  i32xn is_upper = y0 > x0;
+  f32xn x1 = noise_select(is_upper, x0 + (float)G2, x0 + ((float)G2 - 1));
+  f32xn y1 = noise_select(is_upper, y0 + ((float)G2 - 1), y0 + (float)G2);
+  u32xn ip1 = ip + ((u32xn)~is_upper & (uint32_t)PRIME_X);
+  u32xn jp1 = jp + ((u32xn)is_upper & (uint32_t)PRIME_Y);
+
+  f32xn b = 0.5f - x1 * x1 - y1 * y1;
+  f32xn n1 = noise_select(
+    b > zero, (b * b) * (b * b) * noise_grad(s, ip1, jp1, x1, y1), zero);
+
+  return (n0 + n1 + n2) * 99.83685446303647f;
+}
+
+// fnlGetNoise2D for opensimplex2 with no fractal or fbm
+[[gnu::always_inline]]
+inline static f32xn noise_sample(fnl_state* st, f32xn x, f32xn y) {
+  // _fnlTransformNoiseCoordinate2D
+  const FNLfloat SQRT3 = (FNLfloat)1.7320508075688772935274463415059;
+  const FNLfloat F2 = 0.5f * (SQRT3 - 1);
+  x *= st->frequency;
+  y *= st->frequency;
+  f32xn t = (x + y) * F2;
+  x += t;
+  y += t;
+
+  if (st->fractal_type != FNL_FRACTAL_FBM) {
+    return noise_simplex(st->seed, x, y);
+  }
+
+  // _fnlGenFractalFBM2D; amp turns per-lane once weighted_strength kicks in
+  int seed = st->seed;
+  f32xn sum = {};
+  f32xn amp = noise_splat(_fnlCalculateFractalBounding(st));
+
+  for (int i = 0; i < st->octaves; i++) {
+    f32xn noise = noise_simplex(seed++, x, y);
+    sum += noise * amp;
+
+    f32xn up = noise + 1;
+    f32xn up_min = noise_select(up < 2, up, noise_splat(2));
+    amp *= 1.0f + st->weighted_strength * (up_min * 0.5f - 1.0f);
+
+    x *= st->lacunarity;
+    y *= st->lacunarity;
+    amp *= st->gain;
+  }
+
+  return sum;
+}
+
+[[gnu::always_inline]]
+inline static void
+noise_grid_lanes(fnl_state* s, float const* xs, int nx, float const* zs,
+                 int nz, float* out) {
+  for (int i = 0; i < nx; i++) {
+    f32xn x = noise_splat(xs[i]);
+
+    for (int j = 0; j < nz; j += noise_lanes) {
+      int n = nz - j < noise_lanes ? nz - j : noise_lanes;
+
+      // pad the tail with the last point; the extra lanes are not stored
+      f32xn z;
+      for (int k = 0; k < noise_lanes; k++) {
+        z[k] = zs[j + (k < n ? k : n - 1)];
+      }
+
+      f32xn y = noise_sample(s, x, z);
+      for (int k = 0; k < n; k++) {
+        out[i * nz + j + k] = y[k];
+      }
+    }
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+[[gnu::target("avx2")]]
+static void noise_grid_avx2(fnl_state* s, float const* xs, int nx,
+                            float const* zs, int nz, float* out) {
+  noise_grid_lanes(s, xs, nx, zs, nz, out);
+}
+
+#endif
+
+static void noise_grid_base(fnl_state* s, float const* xs, int nx,
+                            float const* zs, int nz, float* out) {
+  noise_grid_lanes(s, xs, nx, zs, nz, out);
+}
+
+bool noise_is_vectorized(fnl_state* s) {
+  return s->noise_type == FNL_NOISE_OPENSIMPLEX2 &&
+         (s->fractal_type == FNL_FRACTAL_NONE ||
+          s->fractal_type == FNL_FRACTAL_FBM);
+}
+
+char const* noise_get_isa() {
+#if defined(__x86_64__) || defined(__i386__)
+  return cpu_has_avx2() ? "avx2" : "sse2";
+#else
+  return "scalar";
+#endif
+}
+
+void noise_grid_2d(fnl_state* s, float const* xs, int nx, float const* zs,
+                   int nz, float* out) {
+  if (!noise_is_vectorized(s)) {
+    for (int i = 0; i < nx; i++) {
+      for (int j = 0; j < nz; j++) {
+        out[i * nz + j] = fnlGetNoise2D(s, xs[i], zs[j]);
+      }
+    }
+
+    return;
+  }
+
+#if defined(__x86_64__) || defined(__i386__)
+  if (cpu_has_avx2()) {
+    noise_grid_avx2(s, xs, nx, zs, nz, out);
+    return;
+  }
+#endif
+
+  noise_grid_base(s, xs, nx, zs, nz, out);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "lib/simplex/FastNoiseLite.h"
+
+/*-- batched 2d noise over a grid of sample points. --*/
+
+// lanes per batch. on x86 the kernel is built twice, for avx2 (one ymm
+// register per vector) and for the baseline sse2 (two xmm registers), and
+// picked once at runtime.
+#define noise_lanes 8
+
+// max abs difference from fnlGetNoise2D over the same points. the kernels do
+// the same float ops in the same order as the scalar code, so results are
+// normally bit-identical; the bound leaves room for compilers that contract
+// to fma.
+#define noise_tolerance 1e-5f
+
+// out[i * nz + j] = fnlGetNoise2D(s, xs[i], zs[j]).
+// opensimplex2 with no fractal or fbm runs vectorized; every other state falls
+// back to the scalar path, still dispatched once per call instead of per point.
+void noise_grid_2d(fnl_state* s, float const* xs, int nx, float const* zs,
+                   int nz, float* out);
+
+// true if noise_grid_2d has a vector kernel for s
+bool noise_is_vectorized(fnl_state* s);
+
+// "avx2", "sse2" or "scalar"
+char const* noise_get_isa();
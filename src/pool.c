@@ -0,0 +1,133 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include "pool.h"
+#include "err.h"
+#include "mem.h"
+
+/*-- task_queue --*/
+
+static void task_queue_push(task_queue* q, task t) {
+  if (q->n_tasks == q->c_tasks) {
+    size_t c_tasks = q->c_tasks ? q->c_tasks * 2 : 64;
+    task* tasks = mem_alloc(mem_tag_pool, sizeof(task) * c_tasks);
+    for (size_t i = 0; i < q->n_tasks; i++) {
+      tasks[i] = q->tasks[(q->head + i) % q->c_tasks];
+    }
+
+    mem_free(q->tasks);
+    q->tasks = tasks;
+    q->c_tasks = c_tasks;
+    q->head = 0;
+  }
+
+  q->tasks[(q->head + q->n_tasks) % q->c_tasks] = t;
+  q->n_tasks++;
+}
+
+static bool task_queue_pop(task_queue* q, task* out) {
+  if (q->n_tasks == 0) {
+    return false;
+  }
+
+  *out = q->tasks[q->head];
+  q->head = (q->head + 1) % q->c_tasks;
+  q->n_tasks--;
+  return true;
+}
+
+/*-- pool --*/
+
+static void* pool_worker(void* arg) {
+  pool* p = arg;
+
+  pthread_mutex_lock(&p->lock);
+  while (true) {
+    task t;
+    while (!p->is_stopping && !task_queue_pop(&p->todo, &t)) {
+      pthread_cond_wait(&p->has_todo, &p->lock);
+    }
+
+    if (p->is_stopping) {
+      break;
+    }
+
+    pthread_mutex_unlock(&p->lock);
+    t.run(t.arg);
+    pthread_mutex_lock(&p->lock);
+
+    task_queue_push(&p->done, t);
+  }
+
+  pthread_mutex_unlock(&p->lock);
+  return NULL;
+}
+
+int pool_get_default_threads() {
+#if defined(_SC_NPROCESSORS_ONLN)
+  long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+  long n_cpus = pthread_num_processors_np();
+#endif
+
+  // leave a core for the render thread
+  return (int)max(n_cpus - 1, 1L);
+}
+
+pool* pool_new(int n_threads) {
+  if (n_threads <= 0) {
+    n_threads = pool_get_default_threads();
+  }
+
+  pool* p = mem_calloc(mem_tag_pool, 1, sizeof(pool));
+  p->threads = mem_alloc(mem_tag_pool, sizeof(pthread_t) * n_threads);
+  p->n_threads = n_threads;
+  pthread_mutex_init(&p->lock, NULL);
+  pthread_cond_init(&p->has_todo, NULL);
+
+  for (int i = 0; i < n_threads; i++) {
+    if (pthread_create(&p->threads[i], NULL, pool_worker, p)) {
+      throw_c("Failed to start a pool worker!");
+    }
+  }
+
+  return p;
+}
+
+void pool_push(pool* p, task t) {
+  pthread_mutex_lock(&p->lock);
+  task_queue_push(&p->todo, t);
+  pthread_mutex_unlock(&p->lock);
+  pthread_cond_signal(&p->has_todo);
+}
+
+bool pool_pop_done(pool* p, task* out) {
+  pthread_mutex_lock(&p->lock);
+  bool has_done = task_queue_pop(&p->done, out);
+  pthread_mutex_unlock(&p->lock);
+  return has_done;
+}
+
+void pool_del(pool* p, void (* drop)(void* arg)) {
+  pthread_mutex_lock(&p->lock);
+  p->is_stopping = true;
+  pthread_mutex_unlock(&p->lock);
+  pthread_cond_broadcast(&p->has_todo);
+
+  for (int i = 0; i < p->n_threads; i++) {
+    pthread_join(p->threads[i], NULL);
+  }
+
+  // a task that was running is in done by now, so this sees every task
+  task t;
+  while (drop && (task_queue_pop(&p->todo, &t) ||
+                  task_queue_pop(&p->done, &t))) {
+    drop(t.arg);
+  }
+
+  mem_free(p->todo.tasks);
+  mem_free(p->done.tasks);
+  mem_free(p->threads);
+  pthread_mutex_destroy(&p->lock);
+  pthread_cond_destroy(&p->has_todo);
+  mem_free(p);
+}
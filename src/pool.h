@@ -0,0 +1,45 @@
+#pragma once
+
+#include <pthread.h>
+#include "typedefs.h"
+
+/*-- a fixed-size pool of worker threads with a completion queue. --*/
+
+typedef struct task {
+  // runs on a worker thread
+  void (* run)(void* arg);
+  void* arg;
+} task;
+
+typedef struct task_queue {
+  task* tasks;
+  size_t head, n_tasks, c_tasks;
+} task_queue;
+
+typedef struct pool {
+  pthread_t* threads;
+  int n_threads;
+
+  // guarded by lock
+  task_queue todo, done;
+  bool is_stopping;
+
+  pthread_mutex_t lock;
+  pthread_cond_t has_todo;
+} pool;
+
+// owning! the workers hold on to the returned pointer, so it must not move.
+pool* pool_new(int n_threads);
+
+// pass n_threads <= 0 to size the pool to the machine
+int pool_get_default_threads();
+
+void pool_push(pool* p, task t);
+
+// pops one finished task into out. never blocks.
+bool pool_pop_done(pool* p, task* out);
+
+// joins the workers, letting running tasks finish first. every task still
+// queued, or finished and not popped, is passed to drop, which may be NULL,
+// so the caller can free its arg.
+void pool_del(pool* p, void (* drop)(void* arg));
@@ -0,0 +1,221 @@
+#include "terrain.h"
+#include "noise.h"
+#include "mem.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+static fnl_state noise;
+static pthread_once_t noise_once = PTHREAD_ONCE_INIT;
+
+static void chunk_init_noise() {
+  noise = fnlCreateState();
+}
+
+// world units to noise units, and noise to world height
+static const float chunk_noise_scale = 4.f;
+static const float chunk_noise_amp = 5.f;
+
+float chunk_get_y(v3f world_pos) {
+  // workers sample concurrently; fnlGetNoise2D only reads the state
+  pthread_once(&noise_once, chunk_init_noise);
+
+  return fnlGetNoise2D(&noise, world_pos.x * chunk_noise_scale,
+                       world_pos.z * chunk_noise_scale) * chunk_noise_amp;
+}
+
+v3f chunk_get_pos(v2i pos, int off_x, int off_z) {
+  v3f base = {
+    pos.x * chunk_size + off_x * chunk_ratio,
+    0,
+    pos.y * chunk_size + off_z * chunk_ratio,
+  };
+
+  base.y = chunk_get_y(base);
+  return base;
+}
+
+float* chunk_new_grid() {
+  float* ys = mem_alloc(mem_tag_world, sizeof(float) * chunk_n_heights);
+  for (int i = 0; i < chunk_n_heights; i++) {
+    ys[i] = NAN;
+  }
+
+  return ys;
+}
+
+static bool chunk_is_grid_corner(int i, int j) {
+  return (i == -1 || i == chunk_len) && (j == -1 || j == chunk_len);
+}
+
+// vectors noise_grid_2d runs to sample n points along z
+static int chunk_n_noise_vecs(int n) {
+  return (n + noise_lanes - 1) / noise_lanes;
+}
+
+void chunk_fill_grid(v2i pos, float* ys) {
+  pthread_once(&noise_once, chunk_init_noise);
+
+  // a row or column is gapped if any of its cells still needs a sample
+  bool is_row_gapped[chunk_grid_len], is_col_gapped[chunk_grid_len];
+  memset(is_row_gapped, 0, sizeof(is_row_gapped));
+  memset(is_col_gapped, 0, sizeof(is_col_gapped));
+  for (int i = -1; i <= chunk_len; i++) {
+    for (int j = -1; j <= chunk_len; j++) {
+      if (!chunk_is_grid_corner(i, j) && isnan(ys[chunk_grid_idx(i, j)])) {
+        is_row_gapped[i + 1] = is_col_gapped[j + 1] = true;
+      }
+    }
+  }
+
+  int rows[chunk_grid_len], cols[chunk_grid_len], n_rows = 0, n_cols = 0;
+  for (int k = -1; k <= chunk_len; k++) {
+    if (is_row_gapped[k + 1]) {
+      rows[n_rows++] = k;
+    }
+
+    if (is_col_gapped[k + 1]) {
+      cols[n_cols++] = k;
+    }
+  }
+
+  if (n_rows == 0) {
+    return;
+  }
+
+  // every gapped cell is in both a gapped row and a gapped column, so either
+  // the gapped rows in full or every row's gapped columns cover them. the
+  // vectors run along z, so an x neighbour's shared rows favour the first and
+  // a z neighbour's shared columns the second; pick whichever is fewer.
+  if (chunk_grid_len * chunk_n_noise_vecs(n_cols) <
+      n_rows * chunk_n_noise_vecs(chunk_grid_len)) {
+    for (n_rows = 0; n_rows < chunk_grid_len; n_rows++) {
+      rows[n_rows] = n_rows - 1;
+    }
+  } else {
+    for (n_cols = 0; n_cols < chunk_grid_len; n_cols++) {
+      cols[n_cols] = n_cols - 1;
+    }
+  }
+
+  float xs[chunk_grid_len], zs[chunk_grid_len];
+  for (int r = 0; r < n_rows; r++) {
+    xs[r] = (pos.x * chunk_size + rows[r] * chunk_ratio) * chunk_noise_scale;
+  }
+
+  for (int c = 0; c < n_cols; c++) {
+    zs[c] = (pos.y * chunk_size + cols[c] * chunk_ratio) * chunk_noise_scale;
+  }
+
+  float samples[n_rows * n_cols];
+  noise_grid_2d(&noise, xs, n_rows, zs, n_cols, samples);
+
+  // cells a neighbour shared are sampled again along the way, but kept as is
+  for (int r = 0; r < n_rows; r++) {
+    for (int c = 0; c < n_cols; c++) {
+      float* y = &ys[chunk_grid_idx(rows[r], cols[c])];
+      if (chunk_is_grid_corner(rows[r], cols[c]) || !isnan(*y)) {
+        continue;
+      }
+
+      *y = samples[r * n_cols + c] * chunk_noise_amp;
+    }
+  }
+}
+
+// edges are i = 0, i = chunk_qty, j = 0, j = chunk_qty; k runs along the edge
+static int chunk_skirt_edge_idx(int e, int k) {
+  switch (e) {
+    case 0: return k;
+    case 1: return chunk_qty * chunk_len + k;
+    case 2: return k * chunk_len;
+    default: return k * chunk_len + chunk_qty;
+  }
+}
+
+static int chunk_skirt_idx(int e, int k) {
+  return chunk_n_grid_verts + e * chunk_len + k;
+}
+
+chunk_vtx* chunk_build(v2i pos, float* ys, arena* a) {
+  chunk_fill_grid(pos, ys);
+
+  chunk_vtx* verts = arr_new_in(a, chunk_vtx, chunk_n_verts);
+
+  for (int i = 0; i < chunk_len; i++) {
+    for (int j = 0; j < chunk_len; j++) {
+      v3f p = {i * chunk_ratio, ys[chunk_grid_idx(i, j)], j * chunk_ratio};
+
+      // central differences; the apron makes normals match across seams
+      float l = ys[chunk_grid_idx(i - 1, j)];
+      float r = ys[chunk_grid_idx(i + 1, j)];
+      float b = ys[chunk_grid_idx(i, j - 1)];
+      float f = ys[chunk_grid_idx(i, j + 1)];
+
+      arr_push_reserved(verts, (chunk_vtx){
+        .pos = p,
+        .norm = v3_normed((v3f){l - r, 2 * chunk_ratio, b - f})
+      });
+    }
+  }
+
+  // skirts keep the edge's normal, so they shade like the surface above them
+  for (int e = 0; e < 4; e++) {
+    for (int k = 0; k < chunk_len; k++) {
+      chunk_vtx v = verts[chunk_skirt_edge_idx(e, k)];
+      v.pos.y -= chunk_skirt_depth;
+      arr_push_reserved(verts, v);
+    }
+  }
+
+  return verts;
+}
+
+void chunk_get_y_range(float* ys, float* min_y, float* max_y) {
+  *min_y = INFINITY;
+  *max_y = -INFINITY;
+
+  for (int i = 0; i < chunk_len; i++) {
+    for (int j = 0; j < chunk_len; j++) {
+      float y = ys[chunk_grid_idx(i, j)];
+      *min_y = fminf(*min_y, y);
+      *max_y = fmaxf(*max_y, y);
+    }
+  }
+}
+
+static void chunk_add_quad(uint16_t** inds, int a, int b, int c, int d) {
+  // abc acd
+  arr_add_n(inds, (uint16_t[]){a, b, c, a, c, d}, 6);
+}
+
+uint16_t* chunk_build_inds() {
+  uint16_t* inds = arr_new(uint16_t, chunk_lod_first_ind(chunk_n_lods));
+
+  for (int lod = 0; lod < chunk_n_lods; lod++) {
+    int s = 1 << lod;
+
+    for (int i = 0; i < chunk_qty; i += s) {
+      for (int j = 0; j < chunk_qty; j += s) {
+        chunk_add_quad(&inds, i * chunk_len + j, (i + s) * chunk_len + j,
+                       (i + s) * chunk_len + j + s, i * chunk_len + j + s);
+      }
+    }
+
+    for (int e = 0; e < 4; e++) {
+      for (int k = 0; k < chunk_qty; k += s) {
+        chunk_add_quad(&inds, chunk_skirt_edge_idx(e, k),
+                       chunk_skirt_edge_idx(e, k + s),
+                       chunk_skirt_idx(e, k + s), chunk_skirt_idx(e, k));
+      }
+    }
+  }
+
+  return inds;
+}
+
+void chunk_job_run(void* arg) {
+  chunk_job* job = arg;
+  job->verts = chunk_build(job->pos, job->ys, &job->scratch);
+  chunk_get_y_range(job->ys, &job->min_y, &job->max_y);
+}
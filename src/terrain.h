@@ -0,0 +1,116 @@
+#pragma once
+
+#include "typedefs.h"
+#include "arr.h"
+#include "arena.h"
+
+/*-- the cpu side of a chunk: heights and vertices, no gl. --*/
+
+static const int chunk_size = 16;
+static const int chunk_qty = 16;
+static const int chunk_len = chunk_qty + 1;
+static const float chunk_ratio = (float)chunk_size / (float)chunk_qty;
+
+// every chunk is a chunk_len x chunk_len vertex grid, followed by a skirt: a
+// copy of each edge pushed down, which hides the cracks between chunks of
+// different lods.
+static const int chunk_n_grid_verts = chunk_len * chunk_len;
+static const int chunk_n_verts = chunk_n_grid_verts + 4 * chunk_len;
+
+// lod l draws every (1 << l)th vertex of the same grid, so all lods share the
+// vertices and only differ in their range of the shared index buffer.
+#define chunk_n_lods 4
+
+// quads per side at a lod
+[[gnu::always_inline]]
+inline static int chunk_lod_qty(int lod) {
+  return chunk_qty >> lod;
+}
+
+// grid and skirt indices of one lod
+[[gnu::always_inline]]
+inline static int chunk_lod_n_inds(int lod) {
+  int qty = chunk_lod_qty(lod);
+  return (qty * qty + 4 * qty) * 6;
+}
+
+// where a lod's indices start in the shared index buffer
+[[gnu::always_inline]]
+inline static int chunk_lod_first_ind(int lod) {
+  int first = 0;
+  for (int l = 0; l < lod; l++) {
+    first += chunk_lod_n_inds(l);
+  }
+
+  return first;
+}
+
+// heights are kept for the vertex grid plus a one-sample apron on each side,
+// which the smooth normals on the border need.
+static const int chunk_grid_len = chunk_len + 2;
+static const int chunk_n_heights = chunk_grid_len * chunk_grid_len;
+
+// how far the skirt hangs below the edge. a coarse edge can miss the fine
+// one by at most the full height range, twice the noise amplitude.
+static const float chunk_skirt_depth = 10.f;
+
+typedef struct chunk_vtx {
+  // relative to the chunk's corner; the shader adds the per-draw offset
+  v3f pos;
+
+  // smooth normal; flat shading derives its normal in the fragment shader
+  v3f norm;
+} chunk_vtx;
+
+float chunk_get_y(v3f world_pos);
+
+v3f chunk_get_pos(v2i pos, int off_x, int off_z);
+
+// i and j are grid offsets in [-1, chunk_len]
+[[gnu::always_inline]]
+inline static int chunk_grid_idx(int i, int j) {
+  return (i + 1) * chunk_grid_len + (j + 1);
+}
+
+// owning! every sample starts as nan, meaning "not sampled yet".
+float* chunk_new_grid();
+
+// samples every height in ys that is still nan. the apron corners are never
+// read, so they are left alone. sampling is vectorized along whole rows or
+// columns, so the cells a neighbour shared in a gapped line still get
+// sampled, and thrown away; it samples the gapped rows or every row's gapped
+// columns, whichever is fewer vectors.
+void chunk_fill_grid(v2i pos, float* ys);
+
+// cpu side of a chunk, safe to call from any thread. fills ys first. the
+// vertices are an arr on a, which the caller must not share with other
+// threads meanwhile.
+chunk_vtx* chunk_build(v2i pos, float* ys, arena* a);
+
+// min and max height over the vertex grid, ignoring the apron
+void chunk_get_y_range(float* ys, float* min_y, float* max_y);
+
+// indices into the vertex grid for every lod, one after another. shared by
+// every chunk.
+uint16_t* chunk_build_inds();
+
+typedef struct chunk_job {
+  v2i pos;
+
+  // owning! seeded with the edges of resident neighbours, handed over to the
+  // chunk on upload.
+  float* ys;
+
+  // filled in by a worker, on scratch
+  chunk_vtx* verts;
+  float min_y, max_y;
+
+  // staging for verts, rewound once they are uploaded. jobs are reused, so
+  // after the first few chunks staging costs no mallocs at all.
+  arena scratch;
+} chunk_job;
+
+// one chunk's verts and their arr header, in a single block
+#define chunk_job_arena_size (sizeof(chunk_vtx) * chunk_n_verts + 64)
+
+void chunk_job_run(void* arg);
@@ -2,8 +2,12 @@
 
 #include <stdint-gcc.h>
 #include <intrin.h>
+#ifdef __SSE__
+#include <immintrin.h>
+#endif
 #include <stdbool.h>
 #include <math.h>
+#include "hash.h"
 
 typedef uint32_t uint;
 typedef uint8_t byte;
@@ -18,11 +22,6 @@ typedef uint8_t byte;
        __typeof__ (b) _b = (b); \
      _a < _b ? _a : _b; })
 
-#define objdup(...) \
-  ({ __typeof__ (__VA_ARGS__) _a = (__VA_ARGS__); \
-     memcpy(malloc(sizeof(_a)), &_a, sizeof(_a));\
-  })
-
 typedef union v2f {
   struct {
     float x, y;
@@ -257,6 +256,16 @@ typedef union m4f {
 
 static const m4f m4_ident = (m4f){.r = {v4_ux, v4_uy, v4_uz, v4_uw}};
 
+// the widest matrix kernels this build has: "avx", "sse" or "scalar". picked
+// at compile time, since they are all inlined into their callers.
+#if defined(__AVX__)
+#define m4_isa "avx"
+#elif defined(__SSE__)
+#define m4_isa "sse"
+#else
+#define m4_isa "scalar"
+#endif
+
 [[gnu::always_inline]]
 inline static v4f m4_col(m4f* m, int col) {
   return (v4f){m->v[0][col], m->v[1][col], m->v[2][col], m->v[3][col]};
@@ -265,13 +274,69 @@ inline static v4f m4_col(m4f* m, int col) {
 [[gnu::always_inline]]
 inline static m4f m4_tpose(m4f* orig) {
   m4f out;
+#ifdef __SSE__
+  __m128 r0 = _mm_loadu_ps(orig->v[0]), r1 = _mm_loadu_ps(orig->v[1]);
+  __m128 r2 = _mm_loadu_ps(orig->v[2]), r3 = _mm_loadu_ps(orig->v[3]);
+  _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+  _mm_storeu_ps(out.v[0], r0);
+  _mm_storeu_ps(out.v[1], r1);
+  _mm_storeu_ps(out.v[2], r2);
+  _mm_storeu_ps(out.v[3], r3);
+#else
   out.r[0] = m4_col(orig, 0);
   out.r[1] = m4_col(orig, 1);
   out.r[2] = m4_col(orig, 2);
   out.r[3] = m4_col(orig, 3);
+#endif
   return out;
 }
 
+// row vectors: p * m, the shaders' convention. every kernel below sums the
+// rows of m weighted by p's lanes, in the order x, y, z, w, which is the
+// order v4_dot adds in, so the simd and scalar builds agree bit for bit.
+[[gnu::always_inline]]
+inline static v4f m4_transform(m4f* m, v4f p) {
+#ifdef __SSE__
+  __m128 out = _mm_mul_ps(_mm_set1_ps(p.x), _mm_loadu_ps(m->v[0]));
+  out = _mm_add_ps(out, _mm_mul_ps(_mm_set1_ps(p.y), _mm_loadu_ps(m->v[1])));
+  out = _mm_add_ps(out, _mm_mul_ps(_mm_set1_ps(p.z), _mm_loadu_ps(m->v[2])));
+  out = _mm_add_ps(out, _mm_mul_ps(_mm_set1_ps(p.w), _mm_loadu_ps(m->v[3])));
+
+  v4f r;
+  _mm_storeu_ps(r.v, out);
+  return r;
+#else
+  return v4_add(v4_add(v4_add(v4_mul(m->r[0], p.x), v4_mul(m->r[1], p.y)),
+                       v4_mul(m->r[2], p.z)), v4_mul(m->r[3], p.w));
+#endif
+}
+
+// w = 1, so m's translation applies. no perspective divide.
+[[gnu::always_inline]]
+inline static v3f m4_transform_point(m4f* m, v3f p) {
+#ifdef __SSE__
+  // 1 * row 3 is row 3, so it is added as is
+  __m128 out = _mm_mul_ps(_mm_set1_ps(p.x), _mm_loadu_ps(m->v[0]));
+  out = _mm_add_ps(out, _mm_mul_ps(_mm_set1_ps(p.y), _mm_loadu_ps(m->v[1])));
+  out = _mm_add_ps(out, _mm_mul_ps(_mm_set1_ps(p.z), _mm_loadu_ps(m->v[2])));
+  out = _mm_add_ps(out, _mm_loadu_ps(m->v[3]));
+
+  v4f r;
+  _mm_storeu_ps(r.v, out);
+  return (v3f){r.x, r.y, r.z};
+#else
+  v4f out = m4_transform(m, (v4f){p.x, p.y, p.z, 1});
+  return (v3f){out.x, out.y, out.z};
+#endif
+}
+
+// w = 0, for directions and normals
+[[gnu::always_inline]]
+inline static v3f m4_transform_vec(m4f* m, v3f v) {
+  v4f out = m4_transform(m, (v4f){v.x, v.y, v.z, 0});
+  return (v3f){out.x, out.y, out.z};
+}
+
 [[gnu::always_inline]]
 inline static m4f m4_trans(float x, float y, float z) {
   m4f out = m4_ident;
@@ -298,63 +363,236 @@ inline static m4f m4_scale_v(v3f scale) {
   return m4_scale(scale.x, scale.y, scale.z);
 }
 
+// rotations are counter-clockwise looking down the axis at the origin, and
+// laid out for row vectors like m4_trans
 [[gnu::always_inline]]
 inline static m4f m4_rot_x(float radians) {
   float c = cosf(radians);
   float s = sinf(radians);
 
   m4f out = m4_ident;
-  
+  out.r[1] = (v4f){0, c, s, 0};
+  out.r[2] = (v4f){0, -s, c, 0};
+  return out;
 }
 
-static m4f m4_mul_p(m4f* lhs, m4f* rhs) {
-  m4f out;
-  for (int i = 0; i < 4; i++) {
-    for (int j = 0; j < 4; j++) {
-      out.v[i][j] = v4_dot(lhs->r[i], m4_col(rhs, j));
-    }
-  }
+[[gnu::always_inline]]
+inline static m4f m4_rot_y(float radians) {
+  float c = cosf(radians);
+  float s = sinf(radians);
+
+  m4f out = m4_ident;
+  out.r[0] = (v4f){c, 0, -s, 0};
+  out.r[2] = (v4f){s, 0, c, 0};
+  return out;
+}
 
+[[gnu::always_inline]]
+inline static m4f m4_rot_z(float radians) {
+  float c = cosf(radians);
+  float s = sinf(radians);
+
+  m4f out = m4_ident;
+  out.r[0] = (v4f){c, s, 0, 0};
+  out.r[1] = (v4f){-s, c, 0, 0};
   return out;
 }
 
-static m4f m4_mul(m4f lhs, m4f rhs) {
+// axis does not need to be normalized
+[[gnu::always_inline]]
+inline static m4f m4_rot(v3f axis, float radians) {
+  v3f a = v3_normed(axis);
+  float c = cosf(radians);
+  float s = sinf(radians);
+  float t = 1 - c;
+
+  m4f out = m4_ident;
+  out.r[0] = (v4f){t * a.x * a.x + c, t * a.x * a.y + s * a.z,
+                   t * a.x * a.z - s * a.y, 0};
+  out.r[1] = (v4f){t * a.x * a.y - s * a.z, t * a.y * a.y + c,
+                   t * a.y * a.z + s * a.x, 0};
+  out.r[2] = (v4f){t * a.x * a.z + s * a.y, t * a.y * a.z - s * a.x,
+                   t * a.z * a.z + c, 0};
+  return out;
+}
+
+// lhs then rhs: p * m4_mul(lhs, rhs) == (p * lhs) * rhs
+inline static m4f m4_mul_p(m4f* lhs, m4f* rhs) {
   m4f out;
+#if defined(__AVX__)
+  // two rows of lhs a register, against rhs's rows repeated in both halves
+  __m256 b0 = _mm256_broadcast_ps((__m128 const*)rhs->v[0]);
+  __m256 b1 = _mm256_broadcast_ps((__m128 const*)rhs->v[1]);
+  __m256 b2 = _mm256_broadcast_ps((__m128 const*)rhs->v[2]);
+  __m256 b3 = _mm256_broadcast_ps((__m128 const*)rhs->v[3]);
+
+  // two 16 byte loads rather than one 32 byte one: lhs is often a copy just
+  // stored by the caller, and a wide load straddling two narrow stores can
+  // not be forwarded from them
+  for (int i = 0; i < 4; i += 2) {
+    __m256 a = _mm256_insertf128_ps(
+      _mm256_castps128_ps256(_mm_loadu_ps(lhs->v[i])),
+      _mm_loadu_ps(lhs->v[i + 1]), 1);
+    __m256 r = _mm256_mul_ps(_mm256_shuffle_ps(a, a, 0x00), b0);
+    r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(a, a, 0x55), b1));
+    r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(a, a, 0xaa), b2));
+    r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(a, a, 0xff), b3));
+    _mm256_storeu_ps(out.v[i], r);
+  }
+#else
   for (int i = 0; i < 4; i++) {
-    for (int j = 0; j < 4; j++) {
-      out.v[i][j] = v4_dot(lhs.r[i], m4_col(&rhs, j));
-    }
+    out.r[i] = m4_transform(rhs, lhs->r[i]);
   }
+#endif
+  return out;
+}
+
+inline static m4f m4_mul(m4f lhs, m4f rhs) {
+  return m4_mul_p(&lhs, &rhs);
+}
 
+#ifdef __SSE__
+// m4_inv's 2x2 blocks, each a row-major 2x2 in one register
+#define m4_swizzle(v, x, y, z, w) \
+  _mm_shuffle_ps(v, v, _MM_SHUFFLE(w, z, y, x))
+
+// a * b
+[[gnu::always_inline]]
+inline static __m128 m4_mat2_mul(__m128 a, __m128 b) {
+  return _mm_add_ps(_mm_mul_ps(a, m4_swizzle(b, 0, 3, 0, 3)),
+                    _mm_mul_ps(m4_swizzle(a, 1, 0, 3, 2),
+                               m4_swizzle(b, 2, 1, 2, 1)));
+}
+
+// adj(a) * b
+[[gnu::always_inline]]
+inline static __m128 m4_mat2_adj_mul(__m128 a, __m128 b) {
+  return _mm_sub_ps(_mm_mul_ps(m4_swizzle(a, 3, 3, 0, 0), b),
+                    _mm_mul_ps(m4_swizzle(a, 1, 1, 2, 2),
+                               m4_swizzle(b, 2, 3, 0, 1)));
+}
+
+// a * adj(b)
+[[gnu::always_inline]]
+inline static __m128 m4_mat2_mul_adj(__m128 a, __m128 b) {
+  return _mm_sub_ps(_mm_mul_ps(a, m4_swizzle(b, 3, 0, 3, 0)),
+                    _mm_mul_ps(m4_swizzle(a, 1, 0, 3, 2),
+                               m4_swizzle(b, 2, 1, 2, 1)));
+}
+#endif
+
+// general inverse. m must not be singular; there is no check, so a singular
+// m gives infs and nans.
+inline static m4f m4_inv(m4f* m) {
+  m4f out;
+#ifdef __SSE__
+  // blockwise inversion of [a b; c d], 2x2 blocks
+  __m128 r0 = _mm_loadu_ps(m->v[0]), r1 = _mm_loadu_ps(m->v[1]);
+  __m128 r2 = _mm_loadu_ps(m->v[2]), r3 = _mm_loadu_ps(m->v[3]);
+  __m128 a = _mm_movelh_ps(r0, r1), b = _mm_movehl_ps(r1, r0);
+  __m128 c = _mm_movelh_ps(r2, r3), d = _mm_movehl_ps(r3, r2);
+
+  // (|a|, |b|, |c|, |d|)
+  __m128 dets = _mm_sub_ps(
+    _mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(2, 0, 2, 0)),
+               _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(3, 1, 3, 1))),
+    _mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(3, 1, 3, 1)),
+               _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(2, 0, 2, 0))));
+  __m128 det_a = m4_swizzle(dets, 0, 0, 0, 0);
+  __m128 det_b = m4_swizzle(dets, 1, 1, 1, 1);
+  __m128 det_c = m4_swizzle(dets, 2, 2, 2, 2);
+  __m128 det_d = m4_swizzle(dets, 3, 3, 3, 3);
+
+  __m128 d_c = m4_mat2_adj_mul(d, c);
+  __m128 a_b = m4_mat2_adj_mul(a, b);
+
+  // the adjugates of the inverse's blocks
+  __m128 x = _mm_sub_ps(_mm_mul_ps(det_d, a), m4_mat2_mul(b, d_c));
+  __m128 w = _mm_sub_ps(_mm_mul_ps(det_a, d), m4_mat2_mul(c, a_b));
+  __m128 y = _mm_sub_ps(_mm_mul_ps(det_b, c), m4_mat2_mul_adj(d, a_b));
+  __m128 z = _mm_sub_ps(_mm_mul_ps(det_c, b), m4_mat2_mul_adj(a, d_c));
+
+  // |m| = |a| |d| + |b| |c| - tr(adj(a) b adj(d) c)
+  __m128 tr = _mm_mul_ps(a_b, m4_swizzle(d_c, 0, 2, 1, 3));
+  tr = _mm_add_ps(tr, m4_swizzle(tr, 2, 3, 0, 1));
+  tr = _mm_add_ps(tr, m4_swizzle(tr, 1, 0, 3, 2));
+  __m128 det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(det_a, det_d),
+                                     _mm_mul_ps(det_b, det_c)), tr);
+
+  __m128 inv_det = _mm_div_ps(_mm_setr_ps(1, -1, -1, 1), det);
+  x = _mm_mul_ps(x, inv_det);
+  y = _mm_mul_ps(y, inv_det);
+  z = _mm_mul_ps(z, inv_det);
+  w = _mm_mul_ps(w, inv_det);
+
+  // undoes the adjugates while interleaving the blocks back into rows
+  _mm_storeu_ps(out.v[0], _mm_shuffle_ps(x, y, _MM_SHUFFLE(1, 3, 1, 3)));
+  _mm_storeu_ps(out.v[1], _mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 2, 0, 2)));
+  _mm_storeu_ps(out.v[2], _mm_shuffle_ps(z, w, _MM_SHUFFLE(1, 3, 1, 3)));
+  _mm_storeu_ps(out.v[3], _mm_shuffle_ps(z, w, _MM_SHUFFLE(0, 2, 0, 2)));
+#else
+  // cofactors from the 2x2 determinants of the top and bottom row pairs
+  float (*v)[4] = m->v;
+  float s0 = v[0][0] * v[1][1] - v[1][0] * v[0][1];
+  float s1 = v[0][0] * v[1][2] - v[1][0] * v[0][2];
+  float s2 = v[0][0] * v[1][3] - v[1][0] * v[0][3];
+  float s3 = v[0][1] * v[1][2] - v[1][1] * v[0][2];
+  float s4 = v[0][1] * v[1][3] - v[1][1] * v[0][3];
+  float s5 = v[0][2] * v[1][3] - v[1][2] * v[0][3];
+
+  float c5 = v[2][2] * v[3][3] - v[3][2] * v[2][3];
+  float c4 = v[2][1] * v[3][3] - v[3][1] * v[2][3];
+  float c3 = v[2][1] * v[3][2] - v[3][1] * v[2][2];
+  float c2 = v[2][0] * v[3][3] - v[3][0] * v[2][3];
+  float c1 = v[2][0] * v[3][2] - v[3][0] * v[2][2];
+  float c0 = v[2][0] * v[3][1] - v[3][0] * v[2][1];
+
+  float inv_det =
+    1 / (s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+
+  out.v[0][0] = (v[1][1] * c5 - v[1][2] * c4 + v[1][3] * c3) * inv_det;
+  out.v[0][1] = (-v[0][1] * c5 + v[0][2] * c4 - v[0][3] * c3) * inv_det;
+  out.v[0][2] = (v[3][1] * s5 - v[3][2] * s4 + v[3][3] * s3) * inv_det;
+  out.v[0][3] = (-v[2][1] * s5 + v[2][2] * s4 - v[2][3] * s3) * inv_det;
+
+  out.v[1][0] = (-v[1][0] * c5 + v[1][2] * c2 - v[1][3] * c1) * inv_det;
+  out.v[1][1] = (v[0][0] * c5 - v[0][2] * c2 + v[0][3] * c1) * inv_det;
+  out.v[1][2] = (-v[3][0] * s5 + v[3][2] * s2 - v[3][3] * s1) * inv_det;
+  out.v[1][3] = (v[2][0] * s5 - v[2][2] * s2 + v[2][3] * s1) * inv_det;
+
+  out.v[2][0] = (v[1][0] * c4 - v[1][1] * c2 + v[1][3] * c0) * inv_det;
+  out.v[2][1] = (-v[0][0] * c4 + v[0][1] * c2 - v[0][3] * c0) * inv_det;
+  out.v[2][2] = (v[3][0] * s4 - v[3][1] * s2 + v[3][3] * s0) * inv_det;
+  out.v[2][3] = (-v[2][0] * s4 + v[2][1] * s2 - v[2][3] * s0) * inv_det;
+
+  out.v[3][0] = (-v[1][0] * c3 + v[1][1] * c1 - v[1][2] * c0) * inv_det;
+  out.v[3][1] = (v[0][0] * c3 - v[0][1] * c1 + v[0][2] * c0) * inv_det;
+  out.v[3][2] = (-v[3][0] * s3 + v[3][1] * s1 - v[3][2] * s0) * inv_det;
+  out.v[3][3] = (v[2][0] * s3 - v[2][1] * s1 + v[2][2] * s0) * inv_det;
+#endif
   return out;
 }
 
-static m4f m4_look(v3f pos, v3f dir, v3f up) {
+inline static m4f m4_look(v3f pos, v3f dir, v3f up) {
   v3f f = v3_normed(dir);
   v3f s = v3_normed(v3_cross(f, up));
   v3f u = v3_cross(s, f);
 
-  m4f out = {0};
-
-  out.v[0][0] = s.v[0];
-  out.v[0][1] = u.v[0];
-  out.v[0][2] = -f.v[0];
-  out.v[1][0] = s.v[1];
-  out.v[1][1] = u.v[1];
-  out.v[1][2] = -f.v[1];
-  out.v[2][0] = s.v[2];
-  out.v[2][1] = u.v[2];
-  out.v[2][2] = -f.v[2];
-  out.v[3][0] = -v3_dot(s, pos);
-  out.v[3][1] = -v3_dot(u, pos);
-  out.v[3][2] = v3_dot(f, pos);
-  out.v[0][3] = out.v[1][3] = out.v[2][3] = 0.0f;
-  out.v[3][3] = 1.0f;
-
+  // the camera's basis goes in as columns, then the eye is moved to the
+  // origin along it
+  m4f basis = {.r = {
+    {s.x, s.y, s.z, 0},
+    {u.x, u.y, u.z, 0},
+    {-f.x, -f.y, -f.z, 0},
+    {0, 0, 0, 1},
+  }};
+
+  m4f out = m4_tpose(&basis);
+  out.r[3] = m4_transform(&out, (v4f){-pos.x, -pos.y, -pos.z, 1});
   return out;
 }
 
-static m4f m4_persp(float fovy, float aspect, float z_near, float z_far) {
+inline static m4f m4_persp(float fovy, float aspect, float z_near, float z_far) {
   m4f out = {0};
 
   float f = 1.f / tanf(fovy * 0.5f);
@@ -387,6 +625,43 @@ static m4f m4_ortho(float left, float right, float bottom, float top, float z_ne
   return out;
 }
 
+// planes are (a, b, c, d) with a * x + b * y + c * z + d >= 0 on the inside
+typedef struct frustum {
+  v4f planes[6];
+} frustum;
+
+// view_proj maps row vectors to clip space, like the shaders' p * look * proj
+inline static frustum frustum_new(m4f view_proj) {
+  v4f x = m4_col(&view_proj, 0), y = m4_col(&view_proj, 1),
+    z = m4_col(&view_proj, 2), w = m4_col(&view_proj, 3);
+
+  return (frustum){
+    .planes = {
+      v4_add(w, x), v4_sub(w, x),
+      v4_add(w, y), v4_sub(w, y),
+      v4_add(w, z), v4_sub(w, z)
+    }
+  };
+}
+
+// conservative: boxes straddling a plane count as inside
+inline static bool frustum_has_aabb(frustum* f, v3f min, v3f max) {
+  for (int i = 0; i < 6; i++) {
+    v4f p = f->planes[i];
+
+    // the corner furthest along the plane's normal
+    v3f corner = {p.x > 0 ? max.x : min.x,
+               p.y > 0 ? max.y : min.y,
+               p.z > 0 ? max.z : min.z};
+
+    if (p.x * corner.x + p.y * corner.y + p.z * corner.z + p.w < 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
 [[gnu::always_inline]]
 inline static float lerp(float start, float end, float delta) {
   return start + (end - start) * delta;
@@ -405,7 +680,7 @@ inline static float rad(float deg) {
 static size_t iv2_hash(void* key) {
   v2i* vec = key;
 
-  return ((size_t)vec->v[0] << 32) | ((size_t)vec->v[1]);
+  return (size_t)hash_i32x2(vec->v[0], vec->v[1]);
 }
 
 static bool iv2_eq(void* _lhs, void* _rhs) {
@@ -413,4 +688,18 @@ static bool iv2_eq(void* _lhs, void* _rhs) {
   v2i* rhs = _rhs;
 
   return lhs->v[0] == rhs->v[0] && lhs->v[1] == rhs->v[1];
+}
+
+// for keys that are a char const*. the strings are compared, not the pointers
+static size_t str_hash(void* key) {
+  char const* s = *(char const**)key;
+
+  return (size_t)hash_bytes(s, strlen(s));
+}
+
+static bool str_eq(void* _lhs, void* _rhs) {
+  char const* lhs = *(char const**)_lhs;
+  char const* rhs = *(char const**)_rhs;
+
+  return strcmp(lhs, rhs) == 0;
 }
\ No newline at end of file
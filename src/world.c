@@ -1,93 +1,502 @@
 #include "world.h"
 #include "typedefs.h"
+#include "mem.h"
+#include <stdlib.h>
 
-float chunk_get_y(v3f world_pos) {
-  static fnl_state* noise = NULL;
-  if (!noise) {
-    noise = objdup(fnlCreateState());
-  }
-
-  return fnlGetNoise2D(noise, world_pos.x * 4, world_pos.z * 4) * 5;
-}
+chunk chunk_upload(v2i pos, chunk_vtx* verts, float* ys, buf* vbo, int slot) {
+  ssize_t n_bytes = (ssize_t)(sizeof(chunk_vtx) * arr_len(verts));
+  ssize_t slot_bytes = (ssize_t)sizeof(chunk_vtx) * chunk_n_verts;
+  buf_sub_data(vbo, slot * slot_bytes, n_bytes, verts);
 
-v3f chunk_get_pos(v2i pos, int off_x, int off_z) {
-  v3f base = {
-    pos.x * chunk_size + off_x * chunk_ratio,
-    0,
-    pos.y * chunk_size + off_z * chunk_ratio,
+  chunk c = {
+    .pos = pos,
+    .slot = slot,
+    .ys = ys,
+    .n_bytes = n_bytes,
+    .is_ready = true
   };
 
-  base.y = chunk_get_y(base);
-  return base;
+  return c;
 }
 
-chunk chunk_new(v2i pos) {
-  chunk_vtx* verts = arr_new(chunk_vtx, 4);
-
-  for (int i = 0; i < chunk_qty; i++) {
-    for (int j = 0; j < chunk_qty; j++) {
-      v3f a = chunk_get_pos(pos, i, j);
-      v3f b = chunk_get_pos(pos, i + 1, j);
-      v3f c = chunk_get_pos(pos, i + 1, j + 1);
-      v3f d = chunk_get_pos(pos, i, j + 1);
+float chunk_get_surface_y(chunk* c, v3f world_pos) {
+  float u = (world_pos.x - (float)(c->pos.x * chunk_size)) / chunk_ratio;
+  float v = (world_pos.z - (float)(c->pos.y * chunk_size)) / chunk_ratio;
 
-      // abc acd
-      v3f n_abc = v3_cross(v3_sub(c, a), v3_sub(b, a));
-      v3f n_acd = v3_cross(v3_sub(d, a), v3_sub(c, a));
+  int i = (int)clamp(floorf(u), 0, chunk_qty - 1);
+  int j = (int)clamp(floorf(v), 0, chunk_qty - 1);
+  float fu = u - (float)i, fv = v - (float)j;
 
-      arr_add(&verts, &(chunk_vtx){.pos = a, .norm = n_abc});
-      arr_add(&verts, &(chunk_vtx){.pos = b, .norm = n_abc});
-      arr_add(&verts, &(chunk_vtx){.pos = c, .norm = n_abc});
+  float a = c->ys[chunk_grid_idx(i, j)];
+  float b = c->ys[chunk_grid_idx(i + 1, j)];
+  float cc = c->ys[chunk_grid_idx(i + 1, j + 1)];
+  float d = c->ys[chunk_grid_idx(i, j + 1)];
 
-      arr_add(&verts, &(chunk_vtx){.pos = a, .norm = n_acd});
-      arr_add(&verts, &(chunk_vtx){.pos = c, .norm = n_acd});
-      arr_add(&verts, &(chunk_vtx){.pos = d, .norm = n_acd});
-    }
+  // same split as the index buffer: abc below the diagonal, acd above
+  if (fu >= fv) {
+    return a + (b - a) * fu + (cc - b) * fv;
   }
 
-  buf vbo = buf_new(GL_ARRAY_BUFFER);
+  return a + (cc - d) * fu + (d - a) * fv;
+}
 
-  buf_data_n(&vbo, GL_STATIC_DRAW, sizeof(chunk_vtx), arr_len(verts), verts);
+bool chunk_is_visible(chunk* c, frustum* f) {
+  v3f min = {(float)(c->pos.x * chunk_size), c->min_y - chunk_skirt_depth,
+             (float)(c->pos.y * chunk_size)};
+  v3f max = {min.x + (float)chunk_size, c->max_y, min.z + (float)chunk_size};
 
-  chunk c = {
-    .vao = vao_new(&vbo, NULL, 3, (attrib[]){attr_3f, attr_3f, attr_2f}),
-    .pos = pos,
-    .n_inds = arr_len(verts)
-  };
+  return frustum_has_aabb(f, min, max);
+}
 
-  return c;
+void chunk_del(chunk* c) {
+  if (!c->is_ready) {
+    return;
+  }
+
+  // the slot goes back to the world's free list, see world_evict
+  mem_free(c->ys);
+  c->ys = NULL;
+  c->is_ready = false;
 }
 
 world world_new() {
+  uint16_t* inds = chunk_build_inds();
+  buf ibo = buf_new(GL_ELEMENT_ARRAY_BUFFER);
+  buf_data_n(&ibo, GL_STATIC_DRAW, sizeof(uint16_t), arr_len(inds), inds);
+  arr_del(inds);
+
+  int n_slots = world_default_max_chunks;
+  buf vbo = buf_new(GL_ARRAY_BUFFER);
+  buf_storage(&vbo, (ssize_t)sizeof(chunk_vtx) * chunk_n_verts * n_slots, NULL,
+              GL_DYNAMIC_STORAGE_BIT);
+
+  // pushed in reverse so the low slots are handed out first
+  int* free_slots = arr_new(int, n_slots);
+  for (int i = n_slots - 1; i >= 0; i--) {
+    arr_push_reserved(free_slots, i);
+  }
+
   world w = {
-    .chunks = map_new(4, sizeof(v2i), sizeof(chunk), 0.75f, iv2_eq, iv2_hash)
+    .chunks = chunk_map_new(world_default_max_chunks, 0.75f),
+    .ring = mem_calloc(mem_tag_world, world_ring_len * world_ring_len,
+                      sizeof(chunk*)),
+    .is_ring_valid = false,
+    .workers = pool_new(0),
+    .free_jobs = arr_new(chunk_job*, 64),
+    .frame_arena = arena_new(64 << 10),
+    .max_chunks = world_default_max_chunks,
+    .max_bytes = world_default_max_bytes,
+    .vbo = vbo,
+    .ibo = ibo,
+    .vao = vao_new(&vbo, &ibo, 2, (attrib[]){attr_3f, attr_3f}),
+    .n_slots = n_slots,
+    .free_slots = free_slots,
+    .cmd_stream = stream_new(GL_DRAW_INDIRECT_BUFFER,
+                             sizeof(draw_elems_cmd) * world_max_draws),
+    .off_stream = stream_new(GL_SHADER_STORAGE_BUFFER,
+                             sizeof(v2f) * world_max_draws),
+    .is_flat_shaded = true
   };
 
   return w;
 }
 
+static void world_job_del(chunk_job* job) {
+  arena_del(&job->scratch);
+  mem_free(job);
+}
+
+// for jobs the workers never got to, or that were never popped
+static void world_drop_job(void* arg) {
+  chunk_job* job = arg;
+  mem_free(job->ys);
+  world_job_del(job);
+}
+
+void world_del(world* w) {
+  // first, since the workers are still writing to the jobs in flight
+  pool_del(w->workers, world_drop_job);
+  w->workers = NULL;
+  w->n_pending = 0;
+
+  for (size_t i = 0; i < w->chunks.n_entries; i++) {
+    chunk_del(w->chunks.vals[i]);
+    mem_free(w->chunks.vals[i]);
+  }
+
+  chunk_map_del(&w->chunks);
+  mem_free(w->ring);
+  w->ring = NULL;
+  w->is_ring_valid = false;
+
+  for (size_t i = 0; i < arr_len(w->free_jobs); i++) {
+    world_job_del(w->free_jobs[i]);
+  }
+
+  arr_del(w->free_jobs);
+  arena_del(&w->frame_arena);
+  arr_del(w->free_slots);
+
+  vao_del(&w->vao);
+  buf_del(&w->vbo);
+  buf_del(&w->ibo);
+  stream_del(&w->cmd_stream);
+  stream_del(&w->off_stream);
+}
+
 v2i world_get_chunk_pos(v3f world_pos) {
-  return (v2i){(int)(world_pos.x / (float)chunk_size),
-               (int)(world_pos.z / (float)chunk_size)};
+  // floor, not truncate, so negative coordinates land in the right chunk
+  return (v2i){(int)floorf(world_pos.x / (float)chunk_size),
+               (int)floorf(world_pos.z / (float)chunk_size)};
+}
+
+int world_get_lod(int ring) {
+  int lod = 0;
+  for (int d = world_lod_dist; ring >= d && lod < chunk_n_lods - 1; d *= 2) {
+    lod++;
+  }
+
+  return lod;
+}
+
+static bool world_is_in_ring(world* w, v2i pos) {
+  v2i delta = iv2_sub(pos, w->ring_pos);
+  return w->is_ring_valid && abs(delta.x) <= world_draw_dist &&
+         abs(delta.y) <= world_draw_dist;
+}
+
+static chunk** world_ring_at(world* w, v2i pos) {
+  // positive modulo, so negative coordinates wrap too
+  int x = (pos.x % world_ring_len + world_ring_len) % world_ring_len;
+  int z = (pos.y % world_ring_len + world_ring_len) % world_ring_len;
+  return &w->ring[x * world_ring_len + z];
+}
+
+static chunk* world_map_find_chunk(world* w, v2i pos) {
+  chunk** ch = chunk_map_at(&w->chunks, pos);
+  return ch ? *ch : NULL;
+}
+
+chunk* world_find_chunk(world* w, v2i pos) {
+  if (world_is_in_ring(w, pos)) {
+    return *world_ring_at(w, pos);
+  }
+
+  return world_map_find_chunk(w, pos);
+}
+
+void world_scroll(world* w, v2i cam_pos) {
+  if (w->is_ring_valid && iv2_eq(&cam_pos, &w->ring_pos)) {
+    return;
+  }
+
+  static const int d = world_draw_dist;
+  v2i delta = iv2_sub(cam_pos, w->ring_pos);
+
+  // a jump past the whole window, or the first scroll, refreshes every cell
+  bool is_full = !w->is_ring_valid || abs(delta.x) >= world_ring_len ||
+                 abs(delta.y) >= world_ring_len;
+
+  // the range of j that is new in every column that is not new itself
+  int j_lo = delta.y > 0 ? d - delta.y + 1 : -d;
+  int j_hi = delta.y > 0 ? d : -d - delta.y - 1;
+
+  for (int i = -d; i <= d; i++) {
+    bool is_new_col = is_full || abs(i + delta.x) > d;
+
+    int lo = is_new_col ? -d : j_lo, hi = is_new_col ? d : j_hi;
+    for (int j = lo; j <= hi; j++) {
+      v2i pos = iv2_add_i(cam_pos, i, j);
+      *world_ring_at(w, pos) = world_map_find_chunk(w, pos);
+    }
+  }
+
+  w->ring_pos = cam_pos;
+  w->is_ring_valid = true;
+}
+
+// removes ch from the map and the ring, and frees it
+static void world_forget_chunk(world* w, chunk* ch) {
+  if (world_is_in_ring(w, ch->pos)) {
+    *world_ring_at(w, ch->pos) = NULL;
+  }
+
+  chunk_map_remove(&w->chunks, ch->pos);
+  chunk_del(ch);
+  mem_free(ch);
+}
+
+void world_share_grid(world* w, v2i pos, float* ys) {
+  static const v2i sides[] = {{{-1, 0}}, {{1, 0}}, {{0, -1}}, {{0, 1}}};
+
+  for (int s = 0; s < 4; s++) {
+    v2i side_pos = iv2_add(pos, sides[s]);
+    chunk* side = world_find_chunk(w, side_pos);
+    if (!side || !side->is_ready) {
+      continue;
+    }
+
+    // our (i, j) is the neighbour's (i - dx * chunk_qty, j - dz * chunk_qty)
+    for (int i = -1; i <= chunk_len; i++) {
+      for (int j = -1; j <= chunk_len; j++) {
+        int si = i - sides[s].x * chunk_qty, sj = j - sides[s].y * chunk_qty;
+        if (si < -1 || si > chunk_len || sj < -1 || sj > chunk_len) {
+          continue;
+        }
+
+        float y = side->ys[chunk_grid_idx(si, sj)];
+        if (!isnan(y)) {
+          ys[chunk_grid_idx(i, j)] = y;
+        }
+      }
+    }
+  }
+}
+
+void world_request_chunk(world* w, v2i pos) {
+  // placeholder so the chunk is only requested once
+  bool is_new;
+  chunk** slot = chunk_map_get_or_insert(&w->chunks, pos, &is_new);
+  if (!is_new) {
+    return;
+  }
+
+  chunk* ch = mem_alloc(mem_tag_world, sizeof(chunk));
+  *ch = (chunk){.pos = pos, .is_ready = false, .last_drawn = w->frame};
+  *slot = ch;
+  if (world_is_in_ring(w, pos)) {
+    *world_ring_at(w, pos) = ch;
+  }
+
+  float* ys = chunk_new_grid();
+  world_share_grid(w, pos, ys);
+
+  chunk_job* job;
+  if (!arr_is_empty(w->free_jobs)) {
+    job = *arr_last(w->free_jobs);
+    arr_len(w->free_jobs)--;
+  } else {
+    job = mem_alloc(mem_tag_world, sizeof(chunk_job));
+    job->scratch = arena_new(chunk_job_arena_size);
+  }
+
+  job->pos = pos;
+  job->ys = ys;
+  job->verts = NULL;
+  w->n_pending++;
+  pool_push(w->workers, (task){.run = chunk_job_run, .arg = job});
+}
+
+void world_upload(world* w) {
+  // only real uploads count against the budget; stale jobs are just freed
+  int n_uploads = 0;
+  task t;
+  while (n_uploads < world_upload_budget && pool_pop_done(w->workers, &t)) {
+    chunk_job* job = t.arg;
+    w->n_pending--;
+
+    // the chunk may have been evicted, or evicted and requested again,
+    // while the job was in flight
+    chunk* ch = world_find_chunk(w, job->pos);
+    if (ch && !ch->is_ready && !arr_is_empty(w->free_slots)) {
+      int slot = *arr_last(w->free_slots);
+      arr_len(w->free_slots)--;
+
+      uint64_t last_drawn = ch->last_drawn;
+      *ch = chunk_upload(job->pos, job->verts, job->ys, &w->vbo, slot);
+      ch->last_drawn = last_drawn;
+      ch->min_y = job->min_y;
+      ch->max_y = job->max_y;
+      w->resident_bytes += ch->n_bytes;
+      n_uploads++;
+    } else {
+      // out of slots means the visible set outgrew the budget; forget the
+      // placeholder so the chunk is requested again after the next eviction
+      if (ch && !ch->is_ready) {
+        world_forget_chunk(w, ch);
+      }
+
+      mem_free(job->ys);
+    }
+
+    if (arr_len(w->free_jobs) < world_max_free_jobs) {
+      arena_reset(&job->scratch);
+      arr_push(w->free_jobs, job);
+    } else {
+      world_job_del(job);
+    }
+  }
+}
+
+typedef struct chunk_age {
+  v2i pos;
+  uint64_t last_drawn;
+} chunk_age;
+
+static int chunk_age_cmp(void const* lhs, void const* rhs) {
+  uint64_t l = ((chunk_age const*)lhs)->last_drawn;
+  uint64_t r = ((chunk_age const*)rhs)->last_drawn;
+  return (l > r) - (l < r);
+}
+
+void world_evict(world* w, v2i cam_pos) {
+  size_t n_chunks = w->chunks.n_entries;
+  if (n_chunks <= w->max_chunks && w->resident_bytes <= w->max_bytes) {
+    return;
+  }
+
+  chunk_age* ages = arr_new_in(&w->frame_arena, chunk_age, 64);
+  for (size_t i = 0; i < w->chunks.n_entries; i++) {
+    chunk* ch = w->chunks.vals[i];
+    v2i delta = iv2_sub(ch->pos, cam_pos);
+    if (abs(delta.x) <= world_draw_dist && abs(delta.y) <= world_draw_dist) {
+      continue;
+    }
+
+    arr_push(ages, (chunk_age){ch->pos, ch->last_drawn});
+  }
+
+  qsort(ages, arr_len(ages), sizeof(chunk_age), chunk_age_cmp);
+
+  for (size_t i = 0; i < arr_len(ages); i++) {
+    if (n_chunks <= w->max_chunks && w->resident_bytes <= w->max_bytes) {
+      break;
+    }
+
+    chunk* ch = world_map_find_chunk(w, ages[i].pos);
+    if (ch->is_ready) {
+      w->resident_bytes -= ch->n_bytes;
+      arr_push(w->free_slots, ch->slot);
+    }
+
+    world_forget_chunk(w, ch);
+    n_chunks--;
+  }
+}
+
+size_t world_get_resident_bytes(world* w) {
+  return w->resident_bytes;
+}
+
+bool world_is_settled(world* w) {
+  return w->n_pending == 0;
+}
+
+float world_get_y(world* w, v3f world_pos) {
+  chunk* ch = world_find_chunk(w, world_get_chunk_pos(world_pos));
+  if (!ch || !ch->is_ready) {
+    return chunk_get_y(world_pos);
+  }
+
+  return chunk_get_surface_y(ch, world_pos);
+}
+
+shader* world_get_shader(world* w) {
+  static shader* sh = NULL;
+  static uniform u_flat;
+  if (!sh) {
+    sh = objdup(mem_tag_gl, shader_new(2,
+                                       (shader_spec[]){
+                                         {GL_VERTEX_SHADER,   "res/chunk.vsh"},
+                                         {GL_FRAGMENT_SHADER, "res/chunk.fsh"},
+                                       }));
+
+    u_flat = shader_get_uniform(sh, "u_flat");
+  }
+
+  // the camera comes from the frame block
+  shader_int_at(sh, u_flat, w->is_flat_shaded);
+  shader_bind(sh);
+
+  return sh;
 }
 
 void world_draw(world* w, cam* c, float d) {
   v2i cam_pos = world_get_chunk_pos(cam_get_pos(c, d));
 
-  (void)mod_get_shader(c, m4_ident, d);
+  w->frame++;
+  arena_reset(&w->frame_arena);
+  world_scroll(w, cam_pos);
+  world_upload(w);
 
-  for (int i = -world_draw_dist; i <= world_draw_dist; i++) {
-    for (int j = -world_draw_dist; j <= world_draw_dist; j++) {
-      v2i chunk_pos = iv2_add_i(cam_pos, i, j);
+  (void)world_get_shader(w);
 
-      if (!map_has(&w->chunks, &chunk_pos)) {
-        chunk ch = chunk_new(chunk_pos);
-        map_add(&w->chunks, &chunk_pos, &ch);
-      }
+  // room for every chunk in range; the regions are sized to fit it
+  stream_begin(&w->cmd_stream);
+  stream_begin(&w->off_stream);
+
+  ssize_t cmd_off, off_off;
+  draw_elems_cmd* cmds = stream_alloc(
+    &w->cmd_stream, sizeof(draw_elems_cmd) * world_max_draws, &cmd_off);
+  v2f* offs = stream_alloc(&w->off_stream, sizeof(v2f) * world_max_draws,
+                           &off_off);
+  int n_draws = 0;
+
+  w->n_culled = 0;
+
+  frustum f = cam_get_frustum(c, d);
+
+  w->n_tris = 0;
+
+  // ring by ring from the camera out, so the nearest chunks are requested,
+  // built and uploaded first
+  for (int r = 0; r <= world_draw_dist; r++) {
+    int lod = world_get_lod(r);
+
+    for (int i = -r; i <= r; i++) {
+      // rows strictly inside the ring only have their two end cells on it
+      int step = abs(i) == r ? 1 : 2 * r;
+      for (int j = -r; j <= r; j += step) {
+        v2i chunk_pos = iv2_add_i(cam_pos, i, j);
 
-      chunk* ch = map_at(&w->chunks, &chunk_pos);
-      vao_bind(&ch->vao);
-      gl_draw_arrays(GL_TRIANGLES, 0, ch->n_inds);
+        chunk* ch = *world_ring_at(w, chunk_pos);
+        if (!ch) {
+          world_request_chunk(w, chunk_pos);
+          continue;
+        }
+
+        // culled chunks still count as drawn for eviction; they are in range
+        ch->last_drawn = w->frame;
+        if (!ch->is_ready) {
+          continue;
+        }
+
+        if (!chunk_is_visible(ch, &f)) {
+          w->n_culled++;
+          continue;
+        }
+
+        // gl_DrawID in the shader indexes offs with the command's index.
+        // the mapping is write-only as far as we're concerned, so whole
+        // stores and no reads back.
+        cmds[n_draws] = (draw_elems_cmd){
+          .count = chunk_lod_n_inds(lod),
+          .n_instances = 1,
+          .first_index = chunk_lod_first_ind(lod),
+          .base_vertex = ch->slot * chunk_n_verts,
+          .base_instance = 0
+        };
+        offs[n_draws] = (v2f){(float)(ch->pos.x * chunk_size),
+                              (float)(ch->pos.y * chunk_size)};
+        n_draws++;
+        w->n_tris += chunk_lod_n_inds(lod) / 3;
+      }
     }
   }
+
+  w->n_drawn = n_draws;
+  if (n_draws > 0) {
+    vao_bind(&w->vao);
+    buf_bind(&w->cmd_stream.buf);
+    buf_bind_range(&w->off_stream.buf, 0, off_off,
+                   (ssize_t)sizeof(v2f) * n_draws);
+    gl_multi_draw_elements_indirect(GL_TRIANGLES, GL_UNSIGNED_SHORT,
+                                    (void*)cmd_off, n_draws, 0);
+  }
+
+  // fenced even with nothing drawn, so every region is waited on the same way
+  stream_end(&w->cmd_stream);
+  stream_end(&w->off_stream);
+
+  world_evict(w, cam_pos);
 }
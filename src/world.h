@@ -1,45 +1,166 @@
 #pragma once
 
 #include "gl.h"
-#include "lib/simplex/FastNoiseLite.h"
 #include "arr.h"
 #include "map.h"
+#include "pool.h"
+#include "terrain.h"
 
 /*-- a 3d world using simplex noise. --*/
 
-static const int chunk_size = 16;
-static const int chunk_qty = 16;
-static const int chunk_len = chunk_qty + 1;
-static const float chunk_ratio = (float)chunk_size / (float)chunk_qty;
-
 typedef struct chunk {
-  vao vao;
-  int n_inds;
   v2i pos;
+
+  // where the chunk's vertices live in the world's pooled vbo
+  int slot;
+
+  // height range of the vertex grid, for the chunk's bounding box
+  float min_y, max_y;
+
+  // owning! chunk_n_heights samples, see chunk_grid_at.
+  float* ys;
+
+  // bytes of vertex data on the gpu
+  size_t n_bytes;
+  uint64_t last_drawn;
+
+  // false while a worker is still building the chunk's vertices
+  bool is_ready;
 } chunk;
 
-typedef struct chunk_vtx {
-  v3f pos;
-  v3f norm;
-  v2f padding;
-} chunk_vtx;
+map_definition(chunk_map, v2i, chunk*, iv2_hash, iv2_eq)
+
+// gl side, render thread only. writes verts into slot of the pooled vbo.
+// does not take ownership of verts, but does take ownership of ys.
+chunk chunk_upload(v2i pos, chunk_vtx* verts, float* ys, buf* vbo, int slot);
+
+// height of the meshed surface at a world position inside the chunk
+float chunk_get_surface_y(chunk* c, v3f world_pos);
+
+bool chunk_is_visible(chunk* c, frustum* f);
 
-float chunk_get_y(v3f world_pos);
+void chunk_del(chunk* c);
 
-v3f chunk_get_pos(v2i pos, int off_x, int off_z);
+#define world_draw_dist 32
 
-chunk chunk_new(v2i pos);
+// chunks closer than this many chunks are drawn at lod 0. every further lod
+// covers twice the distance of the one before, and the last lod covers the
+// rest of the draw distance.
+#define world_lod_dist 4
 
-#define world_draw_dist 12
+// max number of finished chunks uploaded to the gpu per frame
+#define world_upload_budget 32
+
+// finished jobs kept for reuse. a new camera position requests thousands of
+// chunks at once, and keeping every one of those jobs' arenas would pin tens
+// of megabytes for good.
+#define world_max_free_jobs (4 * world_upload_budget)
+
+// residency budget, a bit over the (2 * world_draw_dist + 1)^2 chunks in range.
+// chunks within world_draw_dist are never evicted, so the budget can be
+// exceeded if it is smaller than the visible set.
+// world_new sizes the pooled vbo for max_chunks, so it can be lowered later
+// but not raised.
+#define world_default_max_chunks 5120
+#define world_default_max_bytes (96 << 20)
+
+// chunks per side of the square around the camera chunk
+#define world_ring_len (2 * world_draw_dist + 1)
+
+// at most one draw per chunk in the ring, which sizes the draw streams
+#define world_max_draws (world_ring_len * world_ring_len)
 
 typedef struct world {
-  // v2i --> chunk
-  map chunks;
+  // owning! every resident or requested chunk, in range or not. chunks are
+  // heap allocated so the ring can point at them.
+  chunk_map chunks;
+
+  // a toroidal world_ring_len^2 window onto chunks, centred on ring_pos and
+  // indexed by (x mod len, z mod len). when the camera changes chunks only
+  // the rows and columns that scroll in are looked up in the map; every
+  // other lookup in range is a plain index.
+  chunk** ring;
+  v2i ring_pos;
+  bool is_ring_valid;
+
+  // owning!
+  pool* workers;
+
+  // arr of owning! jobs that are done with, kept for their staging arenas
+  chunk_job** free_jobs;
+
+  // jobs pushed to the workers and not popped back yet
+  int n_pending;
+
+  // reset at the start of every world_draw
+  arena frame_arena;
+
+  // every chunk's vertices are sub-allocated from one immutable vbo in
+  // fixed-size slots, indexed by the one shared ibo and drawn with one
+  // multi-draw-indirect call
+  buf vbo, ibo;
+  vao vao;
+  int n_slots;
+
+  // arr of free slots in vbo, used as a stack
+  int* free_slots;
+
+  // rebuilt every frame: one command and one chunk offset per drawn chunk,
+  // written straight into the streams' mapped regions
+  stream cmd_stream, off_stream;
+
+  bool is_flat_shaded;
+
+  // stats from the last world_draw
+  int n_drawn, n_culled;
+  size_t n_tris;
+
+  size_t max_chunks, max_bytes, resident_bytes;
+  uint64_t frame;
 } world;
 
 // requires an opengl context!
 world world_new();
 
+// frees every chunk and everything else the world owns, gl side included
+void world_del(world* w);
+
 v2i world_get_chunk_pos(v3f world_pos);
 
+// lod of a chunk ring chunks away from the camera's chunk
+int world_get_lod(int ring);
+
+// the chunk at pos, or NULL. from the ring if pos is in range of ring_pos.
+chunk* world_find_chunk(world* w, v2i pos);
+
+// moves the ring's centre to cam_pos, refreshing the cells that scroll in
+void world_scroll(world* w, v2i cam_pos);
+
+// copies the heights ys shares with any resident neighbour of pos
+void world_share_grid(world* w, v2i pos, float* ys);
+
+// does nothing if pos is already requested or resident
+void world_request_chunk(world* w, v2i pos);
+
+void world_upload(world* w);
+
+// evicts the least recently drawn chunks outside the draw distance until the
+// world is back within max_chunks and max_bytes.
+void world_evict(world* w, v2i cam_pos);
+
+size_t world_get_resident_bytes(world* w);
+
+// true once every requested chunk has come back from the workers. a world
+// that stays settled under a still camera should not allocate.
+bool world_is_settled(world* w);
+
+// terrain height at a world position. reads the resident chunk's grid, and
+// only samples noise if the chunk is not resident yet.
+float world_get_y(world* w, v3f world_pos);
+
+// the camera comes from the frame block, see frame_ubo_update
+shader* world_get_shader(world* w);
+
+// c at d is only used for culling and streaming; the shader reads the camera
+// from the frame block, so frame_ubo_update has to have written it this frame
 void world_draw(world* w, cam* c, float d);
\ No newline at end of file